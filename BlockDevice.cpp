@@ -0,0 +1,551 @@
+#include "BlockDevice.h"
+
+namespace FS_NAMESPACE
+{
+
+// 默认的连续读取：逐块读取
+bool BlockDevice::ReadRange(uint32_t first_block, char *buffer, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        if (!Read(first_block + i, buffer + (size_t)i * BLOCK_SIZE))
+            return false;
+    return true;
+}
+
+// 默认的向量写：逐块写入
+bool BlockDevice::WriteRange(uint32_t first_block, const char *const *buffers, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        if (!Write(first_block + i, buffers[i]))
+            return false;
+    return true;
+}
+
+// 默认不支持内存映射
+char *BlockDevice::MapBlock(uint32_t /*block_id*/)
+{
+    return nullptr;
+}
+
+// 默认的异步读：同步执行
+bool BlockDevice::SubmitRead(uint32_t block_id, char *buffer)
+{
+    if (!Read(block_id, buffer))
+        syncFailed = true;
+    return true;
+}
+
+// 默认的异步写：同步执行
+bool BlockDevice::SubmitWrite(uint32_t block_id, const char *buffer)
+{
+    if (!Write(block_id, buffer))
+        syncFailed = true;
+    return true;
+}
+
+// 默认的等待：请求早已完成，只需报告是否有失败
+bool BlockDevice::Wait()
+{
+    bool ok = !syncFailed;
+    syncFailed = false;
+    return ok;
+}
+
+// ---------------- StreamBlockDevice ----------------
+
+bool StreamBlockDevice::Open(const std::string &path)
+{
+    disk.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    return disk.is_open();
+}
+
+void StreamBlockDevice::Close()
+{
+    if (disk.is_open())
+        disk.close();
+}
+
+bool StreamBlockDevice::IsOpen()
+{
+    return disk.is_open();
+}
+
+bool StreamBlockDevice::Read(uint32_t block_id, char *buffer)
+{
+    std::lock_guard<std::mutex> guard(ioMutex);
+    disk.seekg((std::streamoff)block_id * BLOCK_SIZE, std::ios::beg);
+    disk.read(buffer, BLOCK_SIZE);
+    return disk.good();
+}
+
+bool StreamBlockDevice::Write(uint32_t block_id, const char *buffer)
+{
+    std::lock_guard<std::mutex> guard(ioMutex);
+    disk.seekp((std::streamoff)block_id * BLOCK_SIZE, std::ios::beg);
+    disk.write(buffer, BLOCK_SIZE);
+    return disk.good();
+}
+
+bool StreamBlockDevice::Flush()
+{
+    std::lock_guard<std::mutex> guard(ioMutex);
+    disk.flush();
+    return disk.good();
+}
+
+#ifndef _WIN32
+// ---------------- PosixBlockDevice ----------------
+
+PosixBlockDevice::~PosixBlockDevice()
+{
+    Close();
+}
+
+bool PosixBlockDevice::Open(const std::string &path)
+{
+    fd = open(path.c_str(), O_RDWR);
+    return fd >= 0;
+}
+
+void PosixBlockDevice::Close()
+{
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool PosixBlockDevice::IsOpen()
+{
+    return fd >= 0;
+}
+
+bool PosixBlockDevice::Read(uint32_t block_id, char *buffer)
+{
+    return ReadRange(block_id, buffer, 1);
+}
+
+bool PosixBlockDevice::Write(uint32_t block_id, const char *buffer)
+{
+    off_t offset = (off_t)block_id * BLOCK_SIZE;
+    size_t done = 0;
+    while (done < BLOCK_SIZE)
+    {
+        ssize_t n = pwrite(fd, buffer + done, BLOCK_SIZE - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += n;
+    }
+    return true;
+}
+
+bool PosixBlockDevice::Flush()
+{
+    return fdatasync(fd) == 0;
+}
+
+// 一次 pread 读取连续的多个块
+bool PosixBlockDevice::ReadRange(uint32_t first_block, char *buffer, uint32_t count)
+{
+    off_t offset = (off_t)first_block * BLOCK_SIZE;
+    size_t total = (size_t)count * BLOCK_SIZE;
+    size_t done = 0;
+    while (done < total)
+    {
+        ssize_t n = pread(fd, buffer + done, total - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false; // 读到文件末尾也视为失败
+        done += n;
+    }
+    return true;
+}
+
+// 用 pwritev 把多个缓冲区一次写入连续的块，每次最多提交 IOV_MAX 个
+bool PosixBlockDevice::WriteRange(uint32_t first_block, const char *const *buffers, uint32_t count)
+{
+    const uint32_t maxIov = IOV_MAX;
+    std::vector<struct iovec> iov;
+    for (uint32_t start = 0; start < count; start += maxIov)
+    {
+        uint32_t batch = std::min(maxIov, count - start);
+        iov.resize(batch);
+        for (uint32_t i = 0; i < batch; ++i)
+        {
+            iov[i].iov_base = const_cast<char *>(buffers[start + i]);
+            iov[i].iov_len = BLOCK_SIZE;
+        }
+        off_t offset = (off_t)(first_block + start) * BLOCK_SIZE;
+        size_t remaining = (size_t)batch * BLOCK_SIZE;
+        struct iovec *cur = iov.data();
+        int curCount = batch;
+        while (remaining > 0)
+        {
+            ssize_t n = pwritev(fd, cur, curCount, offset);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            remaining -= n;
+            offset += n;
+            // 处理部分写入：跳过已写完的 iovec
+            while (n > 0 && (size_t)n >= cur->iov_len)
+            {
+                n -= cur->iov_len;
+                cur++;
+                curCount--;
+            }
+            if (n > 0)
+            {
+                cur->iov_base = static_cast<char *>(cur->iov_base) + n;
+                cur->iov_len -= n;
+            }
+        }
+    }
+    return true;
+}
+
+// ---------------- MmapBlockDevice ----------------
+
+MmapBlockDevice::~MmapBlockDevice()
+{
+    Close();
+}
+
+// 打开镜像并把整个文件以共享方式映射进内存
+bool MmapBlockDevice::Open(const std::string &path)
+{
+    if (!PosixBlockDevice::Open(path))
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < BLOCK_SIZE)
+    {
+        PosixBlockDevice::Close();
+        return false;
+    }
+    mappedSize = st.st_size;
+    totalBlocks = mappedSize / BLOCK_SIZE;
+    void *addr = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        std::cerr << "错误：映射虚拟磁盘失败!" << std::endl;
+        PosixBlockDevice::Close();
+        return false;
+    }
+    base = static_cast<char *>(addr);
+    return true;
+}
+
+void MmapBlockDevice::Close()
+{
+    if (base != nullptr)
+    {
+        msync(base, mappedSize, MS_SYNC);
+        munmap(base, mappedSize);
+        base = nullptr;
+        mappedSize = 0;
+        totalBlocks = 0;
+    }
+    PosixBlockDevice::Close();
+}
+
+bool MmapBlockDevice::Read(uint32_t block_id, char *buffer)
+{
+    return ReadRange(block_id, buffer, 1);
+}
+
+bool MmapBlockDevice::Write(uint32_t block_id, const char *buffer)
+{
+    return WriteRange(block_id, &buffer, 1);
+}
+
+// 同步映射区中被修改的页到镜像文件
+bool MmapBlockDevice::Flush()
+{
+    return base != nullptr && msync(base, mappedSize, MS_SYNC) == 0;
+}
+
+bool MmapBlockDevice::ReadRange(uint32_t first_block, char *buffer, uint32_t count)
+{
+    if (base == nullptr || first_block + count > totalBlocks)
+        return false;
+    memcpy(buffer, base + (size_t)first_block * BLOCK_SIZE, (size_t)count * BLOCK_SIZE);
+    return true;
+}
+
+bool MmapBlockDevice::WriteRange(uint32_t first_block, const char *const *buffers, uint32_t count)
+{
+    if (base == nullptr || first_block + count > totalBlocks)
+        return false;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        char *dst = base + (size_t)(first_block + i) * BLOCK_SIZE;
+        // 调用者可能直接传入映射区内的地址（原地修改），此时无需拷贝
+        if (buffers[i] != dst)
+            memmove(dst, buffers[i], BLOCK_SIZE);
+    }
+    return true;
+}
+
+char *MmapBlockDevice::MapBlock(uint32_t block_id)
+{
+    if (base == nullptr || block_id >= totalBlocks)
+        return nullptr;
+    return base + (size_t)block_id * BLOCK_SIZE;
+}
+#endif
+
+#ifdef __linux__
+// ---------------- UringBlockDevice ----------------
+
+// 系统调用封装（未依赖 liburing）
+static int IoUringSetup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int IoUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+UringBlockDevice::UringBlockDevice(unsigned depth) : queueDepth(depth) {}
+
+UringBlockDevice::~UringBlockDevice()
+{
+    Close();
+}
+
+bool UringBlockDevice::Open(const std::string &path)
+{
+    if (!PosixBlockDevice::Open(path))
+        return false;
+    // io_uring 不可用（内核过旧或被禁用）时保留同步路径
+    if (!SetupRing())
+        TeardownRing();
+    return true;
+}
+
+void UringBlockDevice::Close()
+{
+    if (ringFd >= 0)
+        Wait();
+    TeardownRing();
+    PosixBlockDevice::Close();
+}
+
+// 是否真正使用 io_uring
+bool UringBlockDevice::IsAsync()
+{
+    return ringFd >= 0;
+}
+
+// 创建 io_uring 实例并映射提交队列、完成队列和 SQE 数组
+bool UringBlockDevice::SetupRing()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringFd = IoUringSetup(queueDepth, &params);
+    if (ringFd < 0)
+        return false;
+    queueDepth = params.sq_entries;
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap)
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+    {
+        sqRing = nullptr;
+        return false;
+    }
+    if (singleMmap)
+        cqRing = sqRing;
+    else
+    {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+        {
+            cqRing = nullptr;
+            return false;
+        }
+    }
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqeMem = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqeMem == MAP_FAILED)
+        return false;
+    sqes = static_cast<struct io_uring_sqe *>(sqeMem);
+    char *sq = static_cast<char *>(sqRing);
+    char *cq = static_cast<char *>(cqRing);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+}
+
+void UringBlockDevice::TeardownRing()
+{
+    if (sqes != nullptr)
+        munmap(sqes, sqesSize);
+    if (cqRing != nullptr && cqRing != sqRing)
+        munmap(cqRing, cqRingSize);
+    if (sqRing != nullptr)
+        munmap(sqRing, sqRingSize);
+    sqes = nullptr;
+    sqRing = cqRing = nullptr;
+    if (ringFd >= 0)
+        close(ringFd);
+    ringFd = -1;
+    toSubmit = inflight = 0;
+    pending.clear();
+    freeSlots.clear();
+}
+
+// 把尚未提交的 SQE 交给内核，并至少等待 minComplete 个完成事件
+bool UringBlockDevice::Enter(unsigned minComplete)
+{
+    while (true)
+    {
+        unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+        int ret = IoUringEnter(ringFd, toSubmit, minComplete, flags);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0)
+            return false;
+        inflight += ret;
+        toSubmit -= ret;
+        return true;
+    }
+}
+
+// 收割完成队列中的所有事件，失败或短读写的请求同步重做
+void UringBlockDevice::Reap()
+{
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail)
+    {
+        struct io_uring_cqe &cqe = cqes[head & *cqMask];
+        uint32_t slot = (uint32_t)cqe.user_data;
+        PendingIo io = pending[slot];
+        freeSlots.push_back(slot);
+        if (cqe.res != BLOCK_SIZE)
+        {
+            bool ok = io.isWrite ? PosixBlockDevice::Write(io.block_id, io.buffer)
+                                 : PosixBlockDevice::Read(io.block_id, io.buffer);
+            if (!ok)
+                ioFailed = true;
+        }
+        inflight--;
+        head++;
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+}
+
+// 向提交队列填入一个读/写请求，队列满时先提交并收割一部分
+bool UringBlockDevice::Queue(uint32_t block_id, char *buffer, bool isWrite)
+{
+    unsigned tail = *sqTail;
+    while (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= queueDepth || inflight + toSubmit >= queueDepth)
+    {
+        if (!Enter(1))
+            return false;
+        Reap();
+        tail = *sqTail;
+    }
+    uint32_t slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        slot = pending.size();
+        pending.emplace_back();
+    }
+    pending[slot] = {block_id, buffer, isWrite};
+    unsigned index = tail & *sqMask;
+    struct io_uring_sqe &sqe = sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = isWrite ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe.fd = fd;
+    sqe.off = (uint64_t)block_id * BLOCK_SIZE;
+    sqe.addr = (uint64_t)(uintptr_t)buffer;
+    sqe.len = BLOCK_SIZE;
+    sqe.user_data = slot;
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    toSubmit++;
+    return true;
+}
+
+bool UringBlockDevice::SubmitRead(uint32_t block_id, char *buffer)
+{
+    if (ringFd < 0)
+        return BlockDevice::SubmitRead(block_id, buffer);
+    if (!Queue(block_id, buffer, false))
+        return BlockDevice::SubmitRead(block_id, buffer);
+    return true;
+}
+
+bool UringBlockDevice::SubmitWrite(uint32_t block_id, const char *buffer)
+{
+    if (ringFd < 0)
+        return BlockDevice::SubmitWrite(block_id, buffer);
+    if (!Queue(block_id, const_cast<char *>(buffer), true))
+        return BlockDevice::SubmitWrite(block_id, buffer);
+    return true;
+}
+
+// 一次提交所有排队的请求并等待全部完成
+bool UringBlockDevice::Wait()
+{
+    bool ok = BlockDevice::Wait();
+    if (ringFd < 0)
+        return ok;
+    while (toSubmit > 0 || inflight > 0)
+    {
+        if (!Enter(inflight + toSubmit))
+        {
+            ok = false;
+            break;
+        }
+        Reap();
+    }
+    ok = ok && !ioFailed;
+    ioFailed = false;
+    return ok;
+}
+#endif
+
+// 根据后端类型创建块设备
+BlockDevice *CreateBlockDevice(DiskBackend backend)
+{
+#ifndef _WIN32
+    if (backend == BACKEND_POSIX)
+        return new PosixBlockDevice();
+    if (backend == BACKEND_MMAP)
+        return new MmapBlockDevice();
+#endif
+#ifdef __linux__
+    if (backend == BACKEND_URING)
+        return new UringBlockDevice();
+#elif !defined(_WIN32)
+    if (backend == BACKEND_URING)
+        return new PosixBlockDevice();
+#endif
+    return new StreamBlockDevice();
+}
+
+} // namespace FS_NAMESPACE
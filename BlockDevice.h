@@ -0,0 +1,150 @@
+#ifndef BLOCK_DEVICE_H
+#define BLOCK_DEVICE_H
+
+#include "FileSystem.h"
+
+namespace FS_NAMESPACE
+{
+
+// 块设备后端接口：DiskManager 通过它访问镜像文件，块号均以 BLOCK_SIZE 为单位
+class BlockDevice
+{
+public:
+    virtual ~BlockDevice() {}
+
+    virtual bool Open(const std::string &path) = 0;
+    virtual void Close() = 0;
+    virtual bool IsOpen() = 0;
+    virtual bool Read(uint32_t block_id, char *buffer) = 0;
+    virtual bool Write(uint32_t block_id, const char *buffer) = 0;
+    virtual bool Flush() = 0;
+
+    // 连续读取 count 个块到一段连续的缓冲区
+    virtual bool ReadRange(uint32_t first_block, char *buffer, uint32_t count);
+    // 将 count 个互不相邻的缓冲区写入从 first_block 开始的连续块
+    virtual bool WriteRange(uint32_t first_block, const char *const *buffers, uint32_t count);
+    // 返回指定块在内存映射中的地址，不支持映射的后端返回 nullptr
+    virtual char *MapBlock(uint32_t block_id);
+
+    // 异步接口：提交的请求在 Wait 返回前完成，缓冲区在此之前必须保持有效
+    // 默认实现直接同步执行，失败记录下来由 Wait 统一报告
+    virtual bool SubmitRead(uint32_t block_id, char *buffer);
+    virtual bool SubmitWrite(uint32_t block_id, const char *buffer);
+    virtual bool Wait();
+
+protected:
+    bool syncFailed = false; // 同步回退路径中是否有请求失败
+};
+
+// 基于 std::fstream 的后端：可移植，但读写共享同一个文件位置，只能用互斥锁串行化
+class StreamBlockDevice : public BlockDevice
+{
+private:
+    std::fstream disk;
+    std::mutex ioMutex; // 定位和读写必须作为一个整体执行
+
+public:
+    bool Open(const std::string &path) override;
+    void Close() override;
+    bool IsOpen() override;
+    bool Read(uint32_t block_id, char *buffer) override;
+    bool Write(uint32_t block_id, const char *buffer) override;
+    bool Flush() override;
+};
+
+#ifndef _WIN32
+// 基于 POSIX 文件描述符的后端：pread/pwrite 不依赖文件位置，可被多个线程同时调用
+class PosixBlockDevice : public BlockDevice
+{
+protected:
+    int fd = -1;
+
+public:
+    ~PosixBlockDevice();
+
+    bool Open(const std::string &path) override;
+    void Close() override;
+    bool IsOpen() override;
+    bool Read(uint32_t block_id, char *buffer) override;
+    bool Write(uint32_t block_id, const char *buffer) override;
+    bool Flush() override;
+    bool ReadRange(uint32_t first_block, char *buffer, uint32_t count) override;
+    bool WriteRange(uint32_t first_block, const char *const *buffers, uint32_t count) override;
+};
+
+// 内存映射后端：整个镜像映射进地址空间，块读写只是内存拷贝，持久化依赖 msync
+class MmapBlockDevice : public PosixBlockDevice
+{
+private:
+    char *base = nullptr;   // 映射起始地址
+    size_t mappedSize = 0;  // 映射长度（字节）
+    uint32_t totalBlocks = 0;
+
+public:
+    ~MmapBlockDevice();
+
+    bool Open(const std::string &path) override;
+    void Close() override;
+    bool Read(uint32_t block_id, char *buffer) override;
+    bool Write(uint32_t block_id, const char *buffer) override;
+    bool Flush() override;
+    bool ReadRange(uint32_t first_block, char *buffer, uint32_t count) override;
+    bool WriteRange(uint32_t first_block, const char *const *buffers, uint32_t count) override;
+    char *MapBlock(uint32_t block_id) override;
+};
+#endif
+
+#ifdef __linux__
+// io_uring 后端：多块读写一次提交、一次收割；内核不支持 io_uring 时退化为同步 pread/pwrite
+class UringBlockDevice : public PosixBlockDevice
+{
+private:
+    // 一个已提交但未完成的请求，失败时用于同步重试
+    struct PendingIo
+    {
+        uint32_t block_id;
+        char *buffer;
+        bool isWrite;
+    };
+
+    int ringFd = -1;
+    unsigned queueDepth;
+    void *sqRing = nullptr;
+    void *cqRing = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    struct io_uring_sqe *sqes = nullptr;
+    size_t sqesSize = 0;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+    unsigned toSubmit = 0;            // 已填入 SQ 但尚未提交给内核的请求数
+    unsigned inflight = 0;            // 已提交但尚未收割的请求数
+    std::vector<PendingIo> pending;   // 以 user_data 为下标
+    std::vector<uint32_t> freeSlots;  // pending 中可复用的下标
+    bool ioFailed = false;
+
+    bool SetupRing();
+    void TeardownRing();
+    bool Queue(uint32_t block_id, char *buffer, bool isWrite);
+    bool Enter(unsigned minComplete);
+    void Reap();
+
+public:
+    explicit UringBlockDevice(unsigned depth = URING_QUEUE_DEPTH);
+    ~UringBlockDevice();
+
+    bool Open(const std::string &path) override;
+    void Close() override;
+    bool SubmitRead(uint32_t block_id, char *buffer) override;
+    bool SubmitWrite(uint32_t block_id, const char *buffer) override;
+    bool Wait() override;
+    bool IsAsync();
+};
+#endif
+
+BlockDevice *CreateBlockDevice(DiskBackend backend);
+
+} // namespace FS_NAMESPACE
+
+#endif
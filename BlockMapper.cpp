@@ -0,0 +1,240 @@
+#include "BlockMapper.h"
+
+namespace FS_NAMESPACE
+{
+
+BlockMapper::BlockMapper(DiskManager *dm, Inode &inode) : disk(dm), node(inode)
+{
+}
+
+BlockMapper::~BlockMapper()
+{
+    Flush();
+}
+
+// 让 cache 装入 ref 指向的间接块；ref 为 0 且 create 为 true 时分配一个新的空间接块并回填 ref
+bool BlockMapper::Open(uint32_t &ref, IndirectBlock &cache, bool create)
+{
+    if (ref != 0 && cache.block_id == ref)
+        return true;
+    if (ref == 0 && !create)
+        return false;
+    // 换入其他块之前先写回被修改过的旧块
+    if (!Store(cache))
+        return false;
+    if (ref == 0)
+    {
+        int newBlock = disk->AllocateExtent(1, disk->GroupGoal(node.inode_id));
+        if (newBlock == -1)
+            return false;
+        ref = newBlock;
+        cache.block_id = ref;
+        memset(cache.ptrs, 0, sizeof(cache.ptrs));
+        cache.dirty = true;
+        return true;
+    }
+    if (!disk->ReadBlock(ref, reinterpret_cast<char *>(cache.ptrs)))
+    {
+        cache.block_id = 0;
+        return false;
+    }
+    cache.block_id = ref;
+    return true;
+}
+
+// 写回一个被修改过的间接块
+bool BlockMapper::Store(IndirectBlock &cache)
+{
+    if (!cache.dirty || cache.block_id == 0)
+        return true;
+    if (!disk->WriteBlock(cache.block_id, reinterpret_cast<char *>(cache.ptrs)))
+        return false;
+    cache.dirty = false;
+    return true;
+}
+
+// 定位逻辑块 index 的块号所在的位置，owner 返回该位置所属的间接块（直接索引时为空）
+uint32_t *BlockMapper::Slot(uint32_t index, bool create, IndirectBlock **owner)
+{
+    *owner = nullptr;
+    // 1. 直接索引（内联文件没有直接索引）
+    if (index < DIRECT_BLOCKS)
+        return (node.flags & INODE_INLINE) ? nullptr : &node.direct_ptr[index];
+    // 2. 一级间接块
+    index -= DIRECT_BLOCKS;
+    if (index < PTRS_PER_BLOCK)
+    {
+        if (!Open(node.single_indirect, single, create))
+            return nullptr;
+        *owner = &single;
+        return &single.ptrs[index];
+    }
+    // 3. 二级间接块：先查顶层块得到下层块号，再查下层块
+    index -= PTRS_PER_BLOCK;
+    if (index >= PTRS_PER_BLOCK * PTRS_PER_BLOCK)
+        return nullptr;
+    if (!Open(node.double_indirect, doubleTop, create))
+        return nullptr;
+    uint32_t &leafRef = doubleTop.ptrs[index / PTRS_PER_BLOCK];
+    uint32_t oldLeaf = leafRef;
+    if (!Open(leafRef, doubleLeaf, create))
+        return nullptr;
+    if (leafRef != oldLeaf)
+        doubleTop.dirty = true;
+    *owner = &doubleLeaf;
+    return &doubleLeaf.ptrs[index % PTRS_PER_BLOCK];
+}
+
+// 查询逻辑块 index 对应的物理块号，未分配时返回 0
+uint32_t BlockMapper::Map(uint32_t index)
+{
+    IndirectBlock *owner;
+    uint32_t *slot = Slot(index, false, &owner);
+    return (slot != nullptr) ? *slot : 0;
+}
+
+// 把逻辑块 index 映射到物理块 block_id（为 0 时解除映射），需要时分配间接块
+bool BlockMapper::Assign(uint32_t index, uint32_t block_id)
+{
+    IndirectBlock *owner;
+    uint32_t *slot = Slot(index, block_id != 0, &owner);
+    if (slot == nullptr)
+        return block_id == 0;
+    if (*slot == 0 && block_id != 0)
+        node.block_count++;
+    else if (*slot != 0 && block_id == 0)
+        node.block_count--;
+    *slot = block_id;
+    if (owner != nullptr)
+        owner->dirty = true;
+    return true;
+}
+
+// 写回所有被修改过的间接块
+bool BlockMapper::Flush()
+{
+    bool ok = Store(single);
+    ok = Store(doubleTop) && ok;
+    ok = Store(doubleLeaf) && ok;
+    return ok;
+}
+
+// 映射逻辑块 [0, count) 时还需要分配的块数：没有映射的数据块，加上还不存在的一级、二级间接块
+// 内联文件的直接索引区不是块号，全部按未映射计算
+uint32_t BlockMapper::MissingBlocks(uint32_t count)
+{
+    count = std::min(count, MAX_FILE_BLOCKS);
+    uint32_t missing = 0;
+    for (uint32_t i = 0; i < count; ++i)
+        if (Map(i) == 0)
+            missing++;
+    if (count > DIRECT_BLOCKS && node.single_indirect == 0)
+        missing++;
+    if (count > DIRECT_BLOCKS + PTRS_PER_BLOCK)
+    {
+        uint32_t leaves = (count - DIRECT_BLOCKS - PTRS_PER_BLOCK + PTRS_PER_BLOCK - 1) / PTRS_PER_BLOCK;
+        if (!Open(node.double_indirect, doubleTop, false))
+            return missing + 1 + leaves;
+        for (uint32_t j = 0; j < leaves; ++j)
+            if (doubleTop.ptrs[j] == 0)
+                missing++;
+    }
+    return missing;
+}
+
+// 收集文件占用的全部物理块：数据块、一级和二级间接块本身，以及目录的哈希索引块
+void BlockMapper::CollectBlocks(std::vector<uint32_t> &blocks)
+{
+    for (uint32_t i = 0; i < node.dir_index_blocks; ++i)
+        blocks.push_back(node.dir_index_start + i);
+    for (uint32_t i = 0; i < DIRECT_BLOCKS && (node.flags & INODE_INLINE) == 0; ++i)
+        if (node.direct_ptr[i] != 0)
+            blocks.push_back(node.direct_ptr[i]);
+    if (Open(node.single_indirect, single, false))
+    {
+        blocks.push_back(single.block_id);
+        for (uint32_t i = 0; i < PTRS_PER_BLOCK; ++i)
+            if (single.ptrs[i] != 0)
+                blocks.push_back(single.ptrs[i]);
+    }
+    if (Open(node.double_indirect, doubleTop, false))
+    {
+        blocks.push_back(doubleTop.block_id);
+        for (uint32_t i = 0; i < PTRS_PER_BLOCK; ++i)
+        {
+            if (!Open(doubleTop.ptrs[i], doubleLeaf, false))
+                continue;
+            blocks.push_back(doubleLeaf.block_id);
+            for (uint32_t j = 0; j < PTRS_PER_BLOCK; ++j)
+                if (doubleLeaf.ptrs[j] != 0)
+                    blocks.push_back(doubleLeaf.ptrs[j]);
+        }
+    }
+}
+
+// 解除逻辑块 keep 及之后的全部映射：释放的数据块和因此变空的间接块都放入 freed，由调用者归还
+void BlockMapper::Release(uint32_t keep, std::vector<uint32_t> &freed)
+{
+    // 1. 直接索引
+    for (uint32_t i = keep; i < DIRECT_BLOCKS && (node.flags & INODE_INLINE) == 0; ++i)
+        if (node.direct_ptr[i] != 0)
+            Drop(node.direct_ptr[i], freed);
+    // 2. 一级间接块：从头开始都不保留时连同间接块本身一起释放
+    uint32_t base = DIRECT_BLOCKS;
+    if (Open(node.single_indirect, single, false))
+    {
+        uint32_t from = (keep > base) ? keep - base : 0;
+        for (uint32_t i = from; i < PTRS_PER_BLOCK; ++i)
+            if (single.ptrs[i] != 0)
+            {
+                Drop(single.ptrs[i], freed);
+                single.dirty = true;
+            }
+        if (from == 0)
+            DropIndirect(node.single_indirect, single, freed);
+    }
+    // 3. 二级间接块：逐个下层块处理，整块不保留的下层块同样释放
+    base += PTRS_PER_BLOCK;
+    if (Open(node.double_indirect, doubleTop, false))
+    {
+        uint32_t from = (keep > base) ? keep - base : 0;
+        for (uint32_t j = from / PTRS_PER_BLOCK; j < PTRS_PER_BLOCK; ++j)
+        {
+            if (!Open(doubleTop.ptrs[j], doubleLeaf, false))
+                continue;
+            uint32_t leafFrom = (j == from / PTRS_PER_BLOCK) ? from % PTRS_PER_BLOCK : 0;
+            for (uint32_t i = leafFrom; i < PTRS_PER_BLOCK; ++i)
+                if (doubleLeaf.ptrs[i] != 0)
+                {
+                    Drop(doubleLeaf.ptrs[i], freed);
+                    doubleLeaf.dirty = true;
+                }
+            if (leafFrom == 0)
+            {
+                DropIndirect(doubleTop.ptrs[j], doubleLeaf, freed);
+                doubleTop.dirty = true;
+            }
+        }
+        if (from == 0)
+            DropIndirect(node.double_indirect, doubleTop, freed);
+    }
+}
+
+// 解除一个数据块的映射
+void BlockMapper::Drop(uint32_t &ptr, std::vector<uint32_t> &freed)
+{
+    freed.push_back(ptr);
+    ptr = 0;
+    node.block_count--;
+}
+
+// 释放一个间接块，缓存中的内容作废，不再写回
+void BlockMapper::DropIndirect(uint32_t &ref, IndirectBlock &cache, std::vector<uint32_t> &freed)
+{
+    freed.push_back(ref);
+    ref = 0;
+    cache.block_id = 0;
+    cache.dirty = false;
+}
+
+} // namespace FS_NAMESPACE
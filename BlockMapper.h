@@ -0,0 +1,50 @@
+#ifndef BLOCK_MAPPER_H
+#define BLOCK_MAPPER_H
+
+#include "FileSystem.h"
+#include "DiskManager.h"
+
+namespace FS_NAMESPACE
+{
+
+// 块映射：把文件内的逻辑块号转换为物理块号
+// 依次经过 10 个直接索引、一级间接块和二级间接块；最近用到的间接块内容缓存在对象中，
+// 顺序访问时每个间接块只读一次，修改过的间接块在 Flush 或析构时写回
+// 间接块号记录在 Inode 中，调用者负责在映射修改后写回 Inode
+// 内联存放的文件（INODE_INLINE）直接索引区里是文件内容，不当作块号使用
+class BlockMapper
+{
+private:
+    struct IndirectBlock
+    {
+        uint32_t block_id = 0; // 当前缓存的间接块号，0 表示未加载
+        bool dirty = false;    // 是否被修改过
+        uint32_t ptrs[PTRS_PER_BLOCK];
+    };
+
+    DiskManager *disk;
+    Inode &node;
+    IndirectBlock single;     // 一级间接块
+    IndirectBlock doubleTop;  // 二级间接块的顶层块
+    IndirectBlock doubleLeaf; // 最近访问的二级间接块的下层块
+
+    bool Open(uint32_t &ref, IndirectBlock &cache, bool create);
+    bool Store(IndirectBlock &cache);
+    uint32_t *Slot(uint32_t index, bool create, IndirectBlock **owner);
+    void Drop(uint32_t &ptr, std::vector<uint32_t> &freed);
+    void DropIndirect(uint32_t &ref, IndirectBlock &cache, std::vector<uint32_t> &freed);
+
+public:
+    BlockMapper(DiskManager *dm, Inode &inode);
+    ~BlockMapper();
+    uint32_t Map(uint32_t index);
+    bool Assign(uint32_t index, uint32_t block_id);
+    bool Flush();
+    uint32_t MissingBlocks(uint32_t count);
+    void CollectBlocks(std::vector<uint32_t> &blocks);
+    void Release(uint32_t keep, std::vector<uint32_t> &freed);
+};
+
+} // namespace FS_NAMESPACE
+
+#endif
@@ -1,5 +1,8 @@
 #include "DirectoryManager.h"
 
+namespace FS_NAMESPACE
+{
+
 DirectoryManager::DirectoryManager(DiskManager *dm)
 {
     this->disk = dm;
@@ -8,15 +11,22 @@ DirectoryManager::DirectoryManager(DiskManager *dm)
 // 初始化根目录
 bool DirectoryManager::InitializeRoot()
 {
+    // 新格式化的磁盘上不可能有之前缓存的目录项
+    {
+        std::lock_guard<std::mutex> guard(dentryMutex);
+        dentryCache.clear();
+    }
+    // 整个操作作为一个事务提交，崩溃后要么全部生效要么全部不生效
+    Transaction txn(disk);
     // 1. 分配根目录的 Inode 编号
     uint32_t rootInodeId = disk->AllocateInode();
     if (rootInodeId != 0)
     {
-        std::cerr << "错误：根目录 Inode 编号不是 0，请检查磁盘初始化状态!" << std::endl;
+        SessionErr() << "错误：根目录 Inode 编号不是 0，请检查磁盘初始化状态!" << std::endl;
         return false;
     }
     // 2. 分配根目录的第一个物理数据块
-    uint32_t rootBlockId = disk->AllocateBlock();
+    uint32_t rootBlockId = disk->AllocateExtent(1, disk->GroupGoal(rootInodeId));
     if (rootBlockId == (uint32_t)-1)
         return false;
     // 3. 初始化 Inode 元数据
@@ -47,6 +57,7 @@ bool DirectoryManager::InitializeRoot()
 // 添加目录项
 bool DirectoryManager::AddDirEntry(uint32_t currentInodeId, const std::string &fileName, uint32_t newInodeId)
 {
+    Transaction txn(disk);
     // 1. 读取当前目录的 Inode 信息
     Inode currentNode;
     if (!disk->ReadInode(currentInodeId, currentNode))
@@ -55,27 +66,32 @@ bool DirectoryManager::AddDirEntry(uint32_t currentInodeId, const std::string &f
     uint32_t currentSize = currentNode.size;
     uint32_t ptrIndex = currentSize / BLOCK_SIZE;      // 使用哪一个 direct_ptr
     uint32_t offsetInBlock = currentSize % BLOCK_SIZE; // 块内的字节偏移
-    // 3. 边界检查：防止超过 10 个直接索引块的上限
-    if (ptrIndex >= (uint32_t)10)
+    // 3. 边界检查：防止超过直接和间接索引能覆盖的块数
+    if (ptrIndex >= MAX_FILE_BLOCKS)
     {
-        std::cerr << "错误：目录已达到最大容量限制!" << std::endl;
+        SessionErr() << "错误：目录已达到最大容量限制!" << std::endl;
         return false;
     }
+    BlockMapper mapper(disk, currentNode);
     // 4. 检查是否需要分配新块
     // 如果 offset 为 0 且 size > 0，说明上一个块刚好填满，需要为当前 ptrIndex 分配新块
     if (offsetInBlock == 0 && currentSize > 0)
     {
-        uint32_t newBlock = disk->AllocateBlock();
+        // 紧挨着上一个目录块申请，让目录块顺序排列
+        uint32_t newBlock = disk->AllocateExtent(1, mapper.Map(ptrIndex - 1) + 1);
         if (newBlock == (uint32_t)-1)
             return false;
-        currentNode.direct_ptr[ptrIndex] = newBlock;
-        currentNode.block_count++;
+        if (!mapper.Assign(ptrIndex, newBlock))
+        {
+            disk->FreeBlock(newBlock);
+            return false;
+        }
         // 此时需要将新块清零，防止读到旧数据
         char zeroBuf[BLOCK_SIZE] = {0};
         disk->WriteBlock(newBlock, zeroBuf);
     }
     // 5. 获取物理块号并读取内容
-    uint32_t physBlockId = currentNode.direct_ptr[ptrIndex];
+    uint32_t physBlockId = mapper.Map(ptrIndex);
     char buffer[BLOCK_SIZE];
     disk->ReadBlock(physBlockId, buffer);
     // 6. 在正确的位置写入新的 DirEntry
@@ -88,75 +104,413 @@ bool DirectoryManager::AddDirEntry(uint32_t currentInodeId, const std::string &f
     // 7. 写回磁盘块
     if (!disk->WriteBlock(physBlockId, buffer))
         return false;
-    // 8. 更新父目录 Inode 的 size 并写回
+    // 8. 更新父目录 Inode 的 size
     currentNode.size += sizeof(DirEntry);
+    // 9. 维护哈希索引：已有索引时插入一个槽位；目录超过一个块或装载率超过一半时（重新）建立索引
+    uint32_t capacity = currentNode.dir_index_blocks * DIR_INDEX_SLOTS_PER_BLOCK;
+    bool indexed = currentNode.dir_index_blocks > 0 && (currentNode.dir_index_used + 1) * 2 <= capacity &&
+                   IndexInsert(currentNode, HashName(newEntry.name), currentSize / sizeof(DirEntry));
+    if (!indexed && currentNode.size > BLOCK_SIZE)
+        BuildIndex(currentNode, mapper);
+    // 10. 写回间接块和父目录 Inode
+    if (!mapper.Flush())
+        return false;
     if (!disk->WriteInode(currentInodeId, currentNode))
         return false;
+    // 11. 目录项缓存以实际写入的（可能被截断的）名字为准，覆盖之前的否定项
+    CacheDentry(currentInodeId, newEntry.name, newInodeId);
     return true;
 }
 
 // 查找 Inode 编号
 uint32_t DirectoryManager::FindInodeId(const std::string &name, uint32_t currentDirInodeId)
 {
+    // 1. 先查目录项缓存，否定项同样算命中
+    {
+        std::lock_guard<std::mutex> guard(dentryMutex);
+        auto it = dentryCache.find(DentryKey{currentDirInodeId, name});
+        if (it != dentryCache.end())
+        {
+            dentryStats.hits++;
+            if (it->second == (uint32_t)-1)
+                dentryStats.negative_hits++;
+            return it->second;
+        }
+        dentryStats.misses++;
+    }
+    // 2. 未命中时查目录，结果（包括不存在）放入缓存
     Inode currentNode;
     if (!disk->ReadInode(currentDirInodeId, currentNode))
         return -1;
-    // 1. 计算目录中总共有多少个条目
-    uint32_t entryCount = currentNode.size / sizeof(DirEntry);
-    char buffer[BLOCK_SIZE];
+    BlockMapper mapper(disk, currentNode);
+    DirEntry entry;
+    uint32_t inodeId = (FindEntry(currentNode, mapper, name, &entry) < 0) ? (uint32_t)-1 : entry.inode_id;
+    CacheDentry(currentDirInodeId, name, inodeId);
+    return inodeId;
+}
+
+// 记录一条目录项缓存，缓存已满时先淘汰四分之一
+void DirectoryManager::CacheDentry(uint32_t parent, const std::string &name, uint32_t inodeId)
+{
+    std::lock_guard<std::mutex> guard(dentryMutex);
+    if (dentryCache.size() >= DENTRY_CACHE_CAPACITY)
+    {
+        size_t target = DENTRY_CACHE_CAPACITY * 3 / 4;
+        for (auto it = dentryCache.begin(); it != dentryCache.end() && dentryCache.size() > target;)
+            it = dentryCache.erase(it);
+    }
+    dentryCache[DentryKey{parent, name}] = inodeId;
+}
+
+// 目录被删除后其 Inode 编号可能被复用，以它为父目录的缓存条目全部失效
+void DirectoryManager::InvalidateChildren(uint32_t dirInodeId)
+{
+    std::lock_guard<std::mutex> guard(dentryMutex);
+    for (auto it = dentryCache.begin(); it != dentryCache.end();)
+    {
+        if (it->first.parent == dirInodeId)
+        {
+            it = dentryCache.erase(it);
+            dentryStats.invalidations++;
+        }
+        else
+            ++it;
+    }
+}
+
+// 清空目录项缓存：只读挂载时镜像由其他进程修改，缓存的查找结果随时可能过期
+void DirectoryManager::ClearDentries()
+{
+    std::lock_guard<std::mutex> guard(dentryMutex);
+    dentryStats.invalidations += dentryCache.size();
+    dentryCache.clear();
+}
+
+// 获取目录项缓存统计信息
+DentryStats DirectoryManager::GetDentryStats()
+{
+    std::lock_guard<std::mutex> guard(dentryMutex);
+    return dentryStats;
+}
+
+// 从目录中移除一个目录项：用最后一个目录项填补空位保持目录紧凑，同时维护哈希索引
+bool DirectoryManager::RemoveDirEntry(uint32_t dirInodeId, const std::string &name)
+{
+    Transaction txn(disk);
+    Inode dirNode;
+    if (!disk->ReadInode(dirInodeId, dirNode))
+        return false;
+    BlockMapper mapper(disk, dirNode);
+    // 1. 定位被删除的目录项
+    DirEntry targetEntry;
+    int64_t targetIdx = FindEntry(dirNode, mapper, name, &targetEntry);
+    if (targetIdx < 0)
+        return false;
+    uint32_t lastIdx = dirNode.size / sizeof(DirEntry) - 1; // 最后一个目录项的下标
+    // 2. 删除的不是最后一个时，把最后一个目录项复制到被删的位置
+    DirEntry lastEntry;
+    if ((uint32_t)targetIdx != lastIdx)
+    {
+        if (!ReadEntry(mapper, lastIdx, lastEntry) || !WriteEntry(mapper, targetIdx, lastEntry))
+            return false;
+    }
+    // 3. 更新索引：被删的槽位标记为已删除，被移动的目录项改指向新位置
+    if (dirNode.dir_index_blocks > 0)
+    {
+        IndexReplace(dirNode, HashName(name.c_str()), targetIdx, DIR_INDEX_DELETED);
+        if ((uint32_t)targetIdx != lastIdx)
+            IndexReplace(dirNode, HashName(lastEntry.name), lastIdx, targetIdx + 1);
+    }
+    // 4. 更新目录大小；如果 size 刚好退回到块边界，最后一个目录块已经空了，释放它
+    dirNode.size -= sizeof(DirEntry);
+    if (dirNode.size > 0 && dirNode.size % BLOCK_SIZE == 0 && dirNode.block_count > 1)
+    {
+        uint32_t emptyIdx = dirNode.size / BLOCK_SIZE;
+        uint32_t emptyBlock = mapper.Map(emptyIdx);
+        if (emptyBlock != 0)
+        {
+            disk->FreeBlock(emptyBlock);
+            mapper.Assign(emptyIdx, 0);
+        }
+    }
+    // 5. 写回间接块和目录 Inode
+    if (!mapper.Flush())
+        return false;
+    if (!disk->WriteInode(dirInodeId, dirNode))
+        return false;
+    // 6. 该名字改为否定项；被删的若是目录，它下面的缓存条目也要失效
+    CacheDentry(dirInodeId, name, (uint32_t)-1);
+    {
+        std::lock_guard<std::mutex> guard(dentryMutex);
+        dentryStats.invalidations++;
+    }
+    InvalidateChildren(targetEntry.inode_id);
+    return true;
+}
+
+// 在目录中查找名字，返回目录项下标（找不到返回 -1），out 不为空时拷贝出目录项
+// 有哈希索引时只访问索引块和目录项所在的块，否则顺序扫描
+int64_t DirectoryManager::FindEntry(const Inode &dirNode, BlockMapper &mapper, const std::string &name, DirEntry *out)
+{
+    uint32_t entryCount = dirNode.size / sizeof(DirEntry);
+    // 1. 通过哈希索引查找：从哈希值对应的槽位开始线性探测，遇到空槽即可断定不存在
+    if (dirNode.dir_index_blocks > 0)
+    {
+        uint32_t hash = HashName(name.c_str());
+        uint32_t capacity = dirNode.dir_index_blocks * DIR_INDEX_SLOTS_PER_BLOCK;
+        for (uint32_t probe = 0; probe < capacity; ++probe)
+        {
+            uint32_t pos = (hash + probe) & (capacity - 1);
+            const char *block = disk->PeekBlock(dirNode.dir_index_start + pos / DIR_INDEX_SLOTS_PER_BLOCK);
+            if (block == nullptr)
+                return -1;
+            DirIndexSlot slot;
+            memcpy(&slot, block + (pos % DIR_INDEX_SLOTS_PER_BLOCK) * sizeof(DirIndexSlot), sizeof(DirIndexSlot));
+            if (slot.entry == DIR_INDEX_EMPTY)
+                return -1;
+            if (slot.entry == DIR_INDEX_DELETED || slot.hash != hash || slot.entry > entryCount)
+                continue;
+            // 哈希相同还要比对名字
+            DirEntry entry;
+            if (ReadEntry(mapper, slot.entry - 1, entry) && name == entry.name)
+            {
+                if (out != nullptr)
+                    *out = entry;
+                return slot.entry - 1;
+            }
+        }
+        return -1;
+    }
+    // 2. 没有索引的小目录：遍历所有条目
+    const char *buffer = nullptr;       // 直接指向缓存或映射区中的目录块，不做拷贝
     uint32_t lastBlockIdx = 0xFFFFFFFF; // 缓存块索引，避免重复读取同一个块
-    // 2. 遍历所有条目
     for (uint32_t i = 0; i < entryCount; ++i)
     {
-        // 计算当前条目在哪个 direct_ptr 索引下，以及块内偏移
+        // 计算当前条目在哪个逻辑块内，以及块内偏移
         uint32_t totalOffset = i * sizeof(DirEntry);
         uint32_t ptrIdx = totalOffset / BLOCK_SIZE;
         uint32_t offsetInBlock = totalOffset % BLOCK_SIZE;
-        // 如果超出了直接索引范围（10个块），则停止
-        if (ptrIdx >= 10)
-            break;
-        // 3. 读取数据块（带有简单的缓存逻辑：如果还在同一个块内，就不重读磁盘）
+        // 读取数据块（带有简单的缓存逻辑：如果还在同一个块内，就不重读磁盘）
         if (ptrIdx != lastBlockIdx)
         {
-            uint32_t physBlockId = currentNode.direct_ptr[ptrIdx];
-            if (!disk->ReadBlock(physBlockId, buffer))
+            // 先完成块映射（可能读入间接块），再取目录块的指针
+            uint32_t physBlockId = mapper.Map(ptrIdx);
+            buffer = (physBlockId != 0) ? disk->PeekBlock(physBlockId) : nullptr;
+            if (buffer == nullptr)
                 continue;
             lastBlockIdx = ptrIdx;
         }
-        // 5. 获取目录项并比对名字
-        DirEntry *entry = reinterpret_cast<DirEntry *>(buffer + offsetInBlock);
-        // 注意：由于是 char 数组，直接比对 string
+        // 获取目录项并比对名字（由于是 char 数组，直接比对 string）
+        const DirEntry *entry = reinterpret_cast<const DirEntry *>(buffer + offsetInBlock);
         if (name == entry->name)
-            return entry->inode_id;
+        {
+            if (out != nullptr)
+                *out = *entry;
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 读取第 idx 个目录项
+bool DirectoryManager::ReadEntry(BlockMapper &mapper, uint32_t idx, DirEntry &out)
+{
+    uint32_t physBlockId = mapper.Map(idx * sizeof(DirEntry) / BLOCK_SIZE);
+    const char *block = (physBlockId != 0) ? disk->PeekBlock(physBlockId) : nullptr;
+    if (block == nullptr)
+        return false;
+    memcpy(&out, block + (idx * sizeof(DirEntry)) % BLOCK_SIZE, sizeof(DirEntry));
+    return true;
+}
+
+// 覆盖第 idx 个目录项
+bool DirectoryManager::WriteEntry(BlockMapper &mapper, uint32_t idx, const DirEntry &entry)
+{
+    uint32_t physBlockId = mapper.Map(idx * sizeof(DirEntry) / BLOCK_SIZE);
+    char buffer[BLOCK_SIZE];
+    if (physBlockId == 0 || !disk->ReadBlock(physBlockId, buffer))
+        return false;
+    memcpy(buffer + (idx * sizeof(DirEntry)) % BLOCK_SIZE, &entry, sizeof(DirEntry));
+    return disk->WriteBlock(physBlockId, buffer);
+}
+
+// 文件名的哈希值（FNV-1a）
+uint32_t DirectoryManager::HashName(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    for (const char *p = name; *p != '\0'; ++p)
+    {
+        hash ^= (uint8_t)*p;
+        hash *= 16777619u;
     }
-    return (uint32_t)-1; // 未找到
+    return hash;
+}
+
+// 向索引插入一个槽位，优先复用探测路径上的已删除槽位
+bool DirectoryManager::IndexInsert(Inode &dirNode, uint32_t hash, uint32_t entryIdx)
+{
+    uint32_t capacity = dirNode.dir_index_blocks * DIR_INDEX_SLOTS_PER_BLOCK;
+    char buffer[BLOCK_SIZE];
+    uint32_t currentBlock = 0xFFFFFFFF;
+    for (uint32_t probe = 0; probe < capacity; ++probe)
+    {
+        uint32_t pos = (hash + probe) & (capacity - 1);
+        uint32_t blockId = dirNode.dir_index_start + pos / DIR_INDEX_SLOTS_PER_BLOCK;
+        if (blockId != currentBlock)
+        {
+            if (!disk->ReadBlock(blockId, buffer))
+                return false;
+            currentBlock = blockId;
+        }
+        DirIndexSlot *slot = reinterpret_cast<DirIndexSlot *>(buffer) + pos % DIR_INDEX_SLOTS_PER_BLOCK;
+        if (slot->entry != DIR_INDEX_EMPTY && slot->entry != DIR_INDEX_DELETED)
+            continue;
+        if (slot->entry == DIR_INDEX_EMPTY)
+            dirNode.dir_index_used++;
+        slot->hash = hash;
+        slot->entry = entryIdx + 1;
+        return disk->WriteBlock(blockId, buffer);
+    }
+    return false;
+}
+
+// 找到指向目录项 oldIdx 的槽位，把它改为 newValue（新的下标 + 1，或 DIR_INDEX_DELETED）
+bool DirectoryManager::IndexReplace(Inode &dirNode, uint32_t hash, uint32_t oldIdx, uint32_t newValue)
+{
+    uint32_t capacity = dirNode.dir_index_blocks * DIR_INDEX_SLOTS_PER_BLOCK;
+    char buffer[BLOCK_SIZE];
+    uint32_t currentBlock = 0xFFFFFFFF;
+    for (uint32_t probe = 0; probe < capacity; ++probe)
+    {
+        uint32_t pos = (hash + probe) & (capacity - 1);
+        uint32_t blockId = dirNode.dir_index_start + pos / DIR_INDEX_SLOTS_PER_BLOCK;
+        if (blockId != currentBlock)
+        {
+            if (!disk->ReadBlock(blockId, buffer))
+                return false;
+            currentBlock = blockId;
+        }
+        DirIndexSlot *slot = reinterpret_cast<DirIndexSlot *>(buffer) + pos % DIR_INDEX_SLOTS_PER_BLOCK;
+        if (slot->entry == DIR_INDEX_EMPTY)
+            return false;
+        if (slot->hash != hash || slot->entry != oldIdx + 1)
+            continue;
+        slot->entry = newValue;
+        return disk->WriteBlock(blockId, buffer);
+    }
+    return false;
+}
+
+// 为目录（重新）建立哈希索引：容量取 2 的幂，建好后装载率不超过 1/4
+// 申请不到连续的索引块时目录退回顺序扫描
+bool DirectoryManager::BuildIndex(Inode &dirNode, BlockMapper &mapper)
+{
+    uint32_t entryCount = dirNode.size / sizeof(DirEntry);
+    uint32_t capacity = DIR_INDEX_SLOTS_PER_BLOCK;
+    while (capacity < entryCount * 4)
+        capacity *= 2;
+    uint32_t numBlocks = capacity / DIR_INDEX_SLOTS_PER_BLOCK;
+    // 1. 释放旧索引
+    if (dirNode.dir_index_blocks > 0)
+        disk->FreeExtent(dirNode.dir_index_start, dirNode.dir_index_blocks);
+    dirNode.dir_index_start = 0;
+    dirNode.dir_index_blocks = 0;
+    dirNode.dir_index_used = 0;
+    // 2. 在目录数据块附近申请一段连续块
+    int start = disk->AllocateExtent(numBlocks, mapper.Map(0));
+    if (start == -1)
+        return false;
+    // 3. 在内存中填好整张哈希表
+    std::vector<DirIndexSlot> slots(capacity, DirIndexSlot{0, DIR_INDEX_EMPTY});
+    for (uint32_t i = 0; i < entryCount; ++i)
+    {
+        DirEntry entry;
+        if (!ReadEntry(mapper, i, entry))
+            continue;
+        uint32_t hash = HashName(entry.name);
+        uint32_t pos = hash & (capacity - 1);
+        while (slots[pos].entry != DIR_INDEX_EMPTY)
+            pos = (pos + 1) & (capacity - 1);
+        slots[pos].hash = hash;
+        slots[pos].entry = i + 1;
+    }
+    // 4. 写入索引块
+    for (uint32_t b = 0; b < numBlocks; ++b)
+        if (!disk->WriteBlock(start + b, reinterpret_cast<char *>(&slots[(size_t)b * DIR_INDEX_SLOTS_PER_BLOCK])))
+        {
+            disk->FreeExtent(start, numBlocks);
+            return false;
+        }
+    dirNode.dir_index_start = start;
+    dirNode.dir_index_blocks = numBlocks;
+    dirNode.dir_index_used = entryCount;
+    return true;
+}
+
+// 打开目录读取游标，offset 为开始读取的目录项下标（用于断点续读）
+bool DirectoryManager::OpenDir(uint32_t dirInodeId, DirCursor &cursor, uint32_t offset)
+{
+    if (!disk->ReadInode(dirInodeId, cursor.node) || (cursor.node.mode >> 9) != TYPE_DIR)
+        return false;
+    cursor.dir_inode_id = dirInodeId;
+    cursor.entry_count = cursor.node.size / sizeof(DirEntry);
+    cursor.offset = offset;
+    cursor.batch_first = 0;
+    cursor.batch_blocks = 0;
+    return true;
+}
+
+// 读取下一批目录项：entries 指向游标缓冲区中当前块内的连续目录项，返回条数，读完返回 0
+// 返回的目录项在下一次 ReadDir 之前有效；每个目录块只读一次，一次批量提交 DIR_READAHEAD_BLOCKS 个块
+uint32_t DirectoryManager::ReadDir(DirCursor &cursor, const DirEntry *&entries)
+{
+    const uint32_t entriesPerBlock = BLOCK_SIZE / sizeof(DirEntry);
+    if (cursor.offset >= cursor.entry_count)
+        return 0;
+    // 1. 当前块不在缓冲区中时，从该块开始批量读入后续若干块
+    uint32_t block = cursor.offset / entriesPerBlock;
+    if (block < cursor.batch_first || block >= cursor.batch_first + cursor.batch_blocks)
+    {
+        uint32_t totalBlocks = (cursor.entry_count + entriesPerBlock - 1) / entriesPerBlock;
+        uint32_t count = std::min(totalBlocks - block, (uint32_t)DIR_READAHEAD_BLOCKS);
+        cursor.batch.assign((size_t)count * BLOCK_SIZE, 0);
+        BlockMapper mapper(disk, cursor.node);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t physBlockId = mapper.Map(block + i);
+            if (physBlockId != 0)
+                disk->SubmitRead(physBlockId, &cursor.batch[(size_t)i * BLOCK_SIZE]);
+        }
+        if (!disk->Wait())
+        {
+            cursor.batch_blocks = 0;
+            return 0;
+        }
+        cursor.batch_first = block;
+        cursor.batch_blocks = count;
+    }
+    // 2. 返回当前块内从 offset 开始的全部目录项
+    uint32_t inBlock = cursor.offset % entriesPerBlock;
+    uint32_t count = std::min(entriesPerBlock - inBlock, cursor.entry_count - cursor.offset);
+    entries = reinterpret_cast<const DirEntry *>(&cursor.batch[(size_t)(block - cursor.batch_first) * BLOCK_SIZE]) + inBlock;
+    cursor.offset += count;
+    return count;
 }
 
 // 列出目录内容
 std::vector<DirEntry> DirectoryManager::ListDirectory(uint32_t dirInodeId)
 {
     std::vector<DirEntry> entries;
-    Inode dirNode;
-    // 1. 读取目录 Inode
-    if (!disk->ReadInode(dirInodeId, dirNode))
+    DirCursor cursor;
+    if (!OpenDir(dirInodeId, cursor))
         return entries;
-    // 2. 计算目录项总数
-    uint32_t count = dirNode.size / sizeof(DirEntry);
-    char buffer[BLOCK_SIZE];
-    // 3. 遍历直接索引块
-    for (uint32_t i = 0; i < count; ++i)
-    {
-        uint32_t totalOffset = i * sizeof(DirEntry);
-        uint32_t ptrIdx = totalOffset / BLOCK_SIZE;
-        uint32_t offsetInBlock = totalOffset % BLOCK_SIZE;
-        if (ptrIdx >= 10)
-            break; // 超过直接索引限制
-        // 读取块
-        uint32_t physBlockId = dirNode.direct_ptr[ptrIdx];
-        disk->ReadBlock(physBlockId, buffer);
-        DirEntry *de = reinterpret_cast<DirEntry *>(buffer + offsetInBlock);
-        if (de->inode_id != (uint32_t)-1)
-            entries.push_back(*de);
-    }
+    const DirEntry *batch;
+    uint32_t count;
+    while ((count = ReadDir(cursor, batch)) > 0)
+        for (uint32_t i = 0; i < count; ++i)
+            if (batch[i].inode_id != (uint32_t)-1)
+                entries.push_back(batch[i]);
     return entries;
-}
\ No newline at end of file
+}
+
+} // namespace FS_NAMESPACE
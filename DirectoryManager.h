@@ -3,18 +3,43 @@
 
 #include "FileSystem.h"
 #include "DiskManager.h"
+#include "BlockMapper.h"
+
+namespace FS_NAMESPACE
+{
 
 class DirectoryManager
 {
 private:
     DiskManager *disk; // 引用底层的磁盘管理器
+    std::unordered_map<DentryKey, uint32_t, DentryKeyHash> dentryCache; // (父目录, 名字) -> Inode 编号，(uint32_t)-1 为否定项
+    DentryStats dentryStats;                                            // 目录项缓存统计
+    std::mutex dentryMutex;                                             // 保护目录项缓存和统计，只读命令可能并发查找
+
+    void CacheDentry(uint32_t parent, const std::string &name, uint32_t inodeId);
+    void InvalidateChildren(uint32_t dirInodeId);
+
+    int64_t FindEntry(const Inode &dirNode, BlockMapper &mapper, const std::string &name, DirEntry *out);
+    bool ReadEntry(BlockMapper &mapper, uint32_t idx, DirEntry &out);
+    bool WriteEntry(BlockMapper &mapper, uint32_t idx, const DirEntry &entry);
+    static uint32_t HashName(const char *name);
+    bool IndexInsert(Inode &dirNode, uint32_t hash, uint32_t entryIdx);
+    bool IndexReplace(Inode &dirNode, uint32_t hash, uint32_t oldIdx, uint32_t newValue);
+    bool BuildIndex(Inode &dirNode, BlockMapper &mapper);
 
 public:
     DirectoryManager(DiskManager *dm);
     bool InitializeRoot();
     bool AddDirEntry(uint32_t currentInodeId, const std::string &fileName, uint32_t newInodeId);
+    bool RemoveDirEntry(uint32_t dirInodeId, const std::string &name);
     uint32_t FindInodeId(const std::string &name, uint32_t currentDirInodeId);
+    bool OpenDir(uint32_t dirInodeId, DirCursor &cursor, uint32_t offset = 0);
+    uint32_t ReadDir(DirCursor &cursor, const DirEntry *&entries);
     std::vector<DirEntry> ListDirectory(uint32_t dirInodeId);
+    void ClearDentries();
+    DentryStats GetDentryStats();
 };
 
-#endif
\ No newline at end of file
+} // namespace FS_NAMESPACE
+
+#endif
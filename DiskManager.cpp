@@ -1,15 +1,22 @@
 #include "DiskManager.h"
 
-DiskManager::DiskManager(const std::string &vdisk_path) : path(vdisk_path)
+namespace FS_NAMESPACE
 {
-    uint32_t bitmapTotalBytes = 8 * BLOCK_SIZE;
-    bitmap.resize(bitmapTotalBytes);
+
+DiskManager::DiskManager(const std::string &vdisk_path, DiskBackend backend) : path(vdisk_path)
+{
+    device = CreateBlockDevice(backend);
+    memset(&sb, 0, sizeof(SuperBlock));
+    uint32_t bitmapTotalBytes = BITMAP_SIZE * BLOCK_SIZE;
+    bitmapStore.resize(bitmapTotalBytes);
+    bitmap = bitmapStore.data();
 }
 
 DiskManager::~DiskManager()
 {
-    if (disk.is_open())
-        disk.close();
+    StopFlusher();
+    device->Close();
+    delete device;
 }
 
 // 检查文件是否存在
@@ -19,9 +26,15 @@ bool DiskManager::FileExists(const std::string &path)
     return (stat(path.c_str(), &buffer) == 0);
 }
 
-// 初始化磁盘
-bool DiskManager::InitializeDisk(const std::string &path)
+// 按给定的几何参数初始化磁盘
+bool DiskManager::InitializeDisk(const std::string &path, const Geometry &geo)
 {
+    if (!geo.Valid())
+    {
+        std::cerr << "错误：磁盘几何参数无效（总块数 " << geo.total_blocks << "，Inode 数 " << geo.inode_count
+                  << "），系统区已经超出磁盘大小！" << std::endl;
+        return false;
+    }
     // 1. 以读写+二进制模式创建/打开文件
     // ios::trunc 确保每次运行都会清空旧文件，重新格式化
     std::fstream fs(path, std::ios::out | std::ios::binary | std::ios::trunc);
@@ -30,26 +43,32 @@ bool DiskManager::InitializeDisk(const std::string &path)
         std::cerr << "错误：无法创建镜像文件！" << std::endl;
         return false;
     }
-    // 2. 预分配空间（16MB）
+    // 2. 预分配空间（总块数 * 块大小）
     // 跳到末尾写一个字节，操作系统会自动分配空洞文件
-    fs.seekp(TOTAL_BLOCKS * BLOCK_SIZE - 1);
+    fs.seekp((std::streamoff)geo.total_blocks * BLOCK_SIZE - 1);
     char null_byte = 0;
     fs.write(&null_byte, 1);
-    // 3. 准备超级块 (Block 0)
+    // 3. 准备超级块 (Block 0)，各区位置全部由几何参数推导
     memset(&sb, 0, sizeof(SuperBlock)); // 先全部清零填充 padding
-    sb.total_blocks = TOTAL_BLOCKS;
+    sb.block_size = BLOCK_SIZE;
+    sb.total_blocks = geo.total_blocks;
+    sb.inode_count = geo.inode_count;
     sb.bitmap_start = 1;
-    sb.inode_start = 9;
-    sb.data_start = 1033;
-    // 初始空闲块 = 总块数 - 系统占用块 (0号到1032号)
-    sb.free_blocks = TOTAL_BLOCKS - 1033;
+    sb.bitmap_blocks = geo.BitmapBlocks();
+    sb.inode_bitmap_offset = geo.InodeBitmapOffset();
+    sb.inode_start = geo.InodeStart();
+    // 日志区紧跟在 Inode 区之后，数据区随之后移
+    sb.journal_start = geo.JournalStart();
+    sb.journal_blocks = JOURNAL_BLOCKS;
+    sb.data_start = geo.DataStart();
+    // 初始空闲块 = 总块数 - 系统占用块 (超级块、位图、Inode 区和日志区)
+    sb.free_blocks = sb.total_blocks - sb.data_start;
     // 写入第 0 块
     fs.seekp(0);
     fs.write(reinterpret_cast<char *>(&sb), sizeof(SuperBlock));
-    // 4. 准备并写入位图 (Block 1 - 8)
-    // 我们需要标记前 8 个位为 1
-    std::vector<uint8_t> bitmap(BLOCK_SIZE * 8, 0);
-    for (uint32_t i = 0; i < 8; ++i)
+    // 4. 准备并写入位图区：系统占用的块全部标记为 1
+    std::vector<uint8_t> bitmap((size_t)sb.bitmap_blocks * BLOCK_SIZE, 0);
+    for (uint32_t i = 0; i < sb.data_start; ++i)
     {
         // 计算在第几个字节，第几个位
         uint32_t byte_idx = i / 8;
@@ -58,16 +77,38 @@ bool DiskManager::InitializeDisk(const std::string &path)
         bitmap[byte_idx] |= (0x80 >> bit_idx);
     }
     // 寻址到 Block 1 的起始位置写入
-    fs.seekp(BLOCK_SIZE * 1);
+    fs.seekp((std::streamoff)BLOCK_SIZE * sb.bitmap_start);
     fs.write(reinterpret_cast<char *>(bitmap.data()), bitmap.size());
-    // 5. 准备并写入空的 Inode 区 (Block 9 - 1032)
+    // 5. 准备并写入空的 Inode 区
     // 这里暂时只填充全 0
     std::vector<char> empty_block(BLOCK_SIZE, 0);
-    fs.seekp(BLOCK_SIZE * 9);
-    for (int i = 0; i < 1024; ++i)
+    fs.seekp((std::streamoff)BLOCK_SIZE * sb.inode_start);
+    for (uint32_t i = 0; i < geo.InodeBlocks(); ++i)
         fs.write(empty_block.data(), BLOCK_SIZE);
     fs.close();
-    this->Mount();
+    return this->Mount();
+}
+
+// 读取超级块：旧镜像没有记录几何参数，按原来的固定布局补齐；块大小必须与编译时一致
+bool DiskManager::LoadSuperBlock()
+{
+    char buffer[BLOCK_SIZE];
+    if (!ReadBlock(0, buffer))
+        return false;
+    memcpy(&sb, buffer, sizeof(SuperBlock));
+    if (sb.block_size == 0)
+    {
+        sb.block_size = 512;
+        sb.inode_count = INODE_BITMAP_BYTES * 8;
+        sb.bitmap_blocks = BITMAP_SIZE;
+        sb.inode_bitmap_offset = INODE_BITMAP_START_BYTE;
+    }
+    if (sb.block_size != BLOCK_SIZE)
+    {
+        std::cerr << "错误：镜像的块大小为 " << sb.block_size << " 字节，当前程序的块大小为 "
+                  << BLOCK_SIZE << " 字节!" << std::endl;
+        return false;
+    }
     return true;
 }
 
@@ -75,28 +116,60 @@ bool DiskManager::InitializeDisk(const std::string &path)
 bool DiskManager::Mount()
 {
     // 1. 打开文件流
-    disk.open(path, std::ios::in | std::ios::out | std::ios::binary);
-    if (!disk.is_open())
+    if (!device->Open(path))
     {
         std::cerr << "错误：无法打开虚拟磁盘文件! " << std::endl;
         return false;
     }
+    // 重新挂载时丢弃旧的缓存内容和未提交的事务
+    ClearCache();
+    {
+        std::lock_guard<std::mutex> guard(stageMutex);
+        txnBlocks.clear();
+        commitBlocks.clear();
+        stagedCount = 0;
+    }
+    {
+        std::lock_guard<std::mutex> guard(reuseMutex);
+        journaledBlocks.clear();
+        freedBlocks.clear();
+    }
+    txnHandles = 0;
+    txnBudget = 0;
+    txnSealing = false;
+    LocalState().depth = 0;
+    mapped = (device->MapBlock(0) != nullptr);
     // 2. 读取超级块到内存 (Block 0)
-    char buffer[BLOCK_SIZE];
-    if (!ReadBlock(0, buffer))
+    if (!LoadSuperBlock())
         return false;
-    memcpy(&sb, buffer, sizeof(SuperBlock));
-    // 3. 根据超级块信息，加载位图到内存 (Block 1 - 8)
-    uint32_t bitmap_total_size = BITMAP_SIZE * BLOCK_SIZE;
-    bitmap.resize(bitmap_total_size);
-    // 定位到位图区起始点
-    disk.seekg(sb.bitmap_start * BLOCK_SIZE, std::ios::beg);
-    disk.read(reinterpret_cast<char *>(bitmap.data()), bitmap_total_size);
-    if (!disk.good())
+    // 3. 有日志的镜像先重放已提交但未写回原位置的事务，重放可能改写超级块，因此要重新读取
+    // 只读挂载时日志属于正在写镜像的进程，不能重放
+    if (JournalEnabled() && !readOnly)
+    {
+        if (!ReplayJournal())
+            return false;
+        ClearCache();
+        if (!LoadSuperBlock())
+            return false;
+    }
+    // 4. 根据超级块信息，从位图区起始点一次读入全部位图块
+    // 映射模式下也使用私有副本：位的修改只能随事务中 SyncBitmapRange 写出的位图块进入映射区，
+    // 否则未提交的分配和释放会先于日志落盘，崩溃后出现泄漏的块或被引用却标记为空闲的块
+    bitmapStore.resize((size_t)sb.bitmap_blocks * BLOCK_SIZE);
+    bitmap = bitmapStore.data();
+    if (!device->ReadRange(sb.bitmap_start, reinterpret_cast<char *>(bitmap), sb.bitmap_blocks))
     {
         std::cerr << "错误：加载位图失败!" << std::endl;
         return false;
     }
+    // 5. 根据位图划分分配组，重建各组的空闲空间摘要树和空闲计数
+    BuildGroups();
+    // 6. 定期写回策略下启动后台写回线程
+    if (durability == DURABILITY_PERIODIC && !readOnly && !flusher.joinable())
+    {
+        flusherStop = false;
+        flusher = std::thread(&DiskManager::FlusherLoop, this);
+    }
     // std::cout << "磁盘已挂载:总块数: " << sb.total_blocks
     //           << ", 空闲块: " << sb.free_blocks << std::endl;
     return true;
@@ -105,179 +178,1551 @@ bool DiskManager::Mount()
 // 卸载磁盘
 void DiskManager::UnMount()
 {
-    if (disk.is_open())
+    // 先停下后台写回线程，剩下的写回由卸载统一完成
+    StopFlusher();
+    if (device->IsOpen() && readOnly)
     {
-        // 1. 强制同步超级块到 Block 0
-        if (!WriteBlock(0, reinterpret_cast<char *>(&sb)))
-            std::cerr << "错误：同步超级块到磁盘失败!" << std::endl;
-        // 2. 强制同步完整的位图区 (Block 1 到 8)
+        // 只读挂载没有要写回的内容
+        ClearCache();
+        device->Close();
+        mapped = false;
+    }
+    else if (device->IsOpen())
+    {
+        // 1. 强制同步超级块到 Block 0（空闲计数由各组汇总）
+        sbDirty = true;
+        FlushSuperBlock();
+        // 2. 强制同步完整的位图区
         // 即使 AllocateBlock 里有单块同步，卸载时全量覆盖可防止内存与磁盘长期的微小偏差
-        disk.seekp(sb.bitmap_start * BLOCK_SIZE, std::ios::beg);
-        disk.write(reinterpret_cast<const char *>(bitmap.data()), bitmap.size());
-        // 3. 刷新缓冲区并关闭文件
-        disk.flush();
-        disk.close();
+        for (uint32_t i = 0; i < sb.bitmap_blocks; ++i)
+            WriteBlock(sb.bitmap_start + i, reinterpret_cast<char *>(&bitmap[i * BLOCK_SIZE]));
+        // 3. 写回缓存中的所有脏块，刷新缓冲区并关闭文件
+        if (!Sync())
+            std::cerr << "错误：写回缓存块到磁盘失败!" << std::endl;
+        ClearCache();
+        device->Close();
+        mapped = false;
     }
 }
 
-// 读取指定块
-bool DiskManager::ReadBlock(uint32_t block_id, char *buffer)
+// 设置只读挂载：镜像的写入权在其他进程手里时，本进程不重放日志、不写任何块，在 Mount 之前调用
+void DiskManager::SetReadOnly(bool value)
 {
-    disk.seekg(block_id * BLOCK_SIZE, std::ios::beg);
-    disk.read(buffer, BLOCK_SIZE);
-    return disk.good();
+    readOnly = value;
 }
 
-// 写入指定块
-bool DiskManager::WriteBlock(uint32_t block_id, char *buffer)
+bool DiskManager::IsReadOnly() const
 {
-    disk.seekp(block_id * BLOCK_SIZE, std::ios::beg);
-    disk.write(buffer, BLOCK_SIZE);
-    disk.flush();
-    return disk.good();
+    return readOnly;
 }
 
-// 申请一个物理空闲块，返回物理块号，失败返回 -1
-int DiskManager::AllocateBlock()
+// 只读挂载时重新读入写入进程已经写回镜像的内容：丢弃块缓存和没有钉住的 Inode，重新读取超级块和位图
+// 钉住的 Inode 属于本进程打开的文件，镜像上的字节范围锁挡住了写入进程对它们的修改，不必重读
+// 调用者保证此时没有其他线程在读这个磁盘管理器
+bool DiskManager::Refresh()
 {
-    // 1. 扫描内存中的位图 (从数据区起始位置开始扫描)
-    for (uint32_t i = sb.data_start; i < sb.total_blocks; ++i)
+    if (!readOnly || !device->IsOpen())
+        return true;
     {
-        uint32_t byte_idx = i / 8;
-        uint32_t bit_idx = i % 8;
-        // 检查该位是否为 0
-        if (!(bitmap[byte_idx] & (0x80 >> bit_idx)))
+        std::lock_guard<std::mutex> inodeGuard(inodeMutex);
+        std::lock_guard<std::mutex> cacheGuard(cacheMutex);
+        cache.clear();
+        cacheIndex.clear();
+        for (auto it = inodeCache.begin(); it != inodeCache.end();)
+            it = (it->second.ref_count == 0) ? inodeCache.erase(it) : std::next(it);
+    }
+    if (!LoadSuperBlock())
+        return false;
+    if (!device->ReadRange(sb.bitmap_start, reinterpret_cast<char *>(bitmap), sb.bitmap_blocks))
+    {
+        std::cerr << "错误：加载位图失败!" << std::endl;
+        return false;
+    }
+    BuildGroups();
+    return true;
+}
+
+// 在缓存中查找指定块，命中则将其移到 LRU 表头（调用者持有 cacheMutex）
+CacheBlock *DiskManager::LookupCache(uint32_t block_id)
+{
+    auto it = cacheIndex.find(block_id);
+    if (it == cacheIndex.end())
+        return nullptr;
+    cache.splice(cache.begin(), cache, it->second);
+    return &cache.front();
+}
+
+// 为指定块分配一个缓存槽位，缓存已满时淘汰最久未使用的块（调用者持有 cacheMutex）
+// 正在装入或写回的块不能淘汰；没有线程再引用的缓冲区直接给新槽位复用
+CacheBlock *DiskManager::InsertCache(uint32_t block_id)
+{
+    std::shared_ptr<char[]> buffer;
+    if (cache.size() >= CACHE_CAPACITY)
+    {
+        auto victim = std::prev(cache.end());
+        while ((victim->loading || victim->flushing) && victim != cache.begin())
+            --victim;
+        if (!victim->loading && !victim->flushing)
+        {
+            // 脏块被淘汰前必须先写回磁盘
+            if (victim->dirty && !WriteBack(*victim))
+                return nullptr;
+            cacheIndex.erase(victim->block_id);
+            if (victim->buffer.use_count() == 1)
+                buffer = std::move(victim->buffer);
+            cache.erase(victim);
+        }
+    }
+    if (buffer == nullptr)
+        buffer.reset(new char[BLOCK_SIZE]);
+    cache.emplace_front();
+    CacheBlock &cb = cache.front();
+    cb.block_id = block_id;
+    cb.buffer = std::move(buffer);
+    cb.data = cb.buffer.get();
+    cacheIndex[block_id] = cache.begin();
+    return &cb;
+}
+
+// 取得指定块的缓存槽位，未命中时装入：装入期间释放缓存锁，其他线程的读写不必等待这次磁盘读
+// 返回时仍持有 lock，槽位中的数据已就绪
+CacheBlock *DiskManager::AcquireBlock(uint32_t block_id, std::unique_lock<std::mutex> &lock)
+{
+    while (true)
+    {
+        CacheBlock *cb = LookupCache(block_id);
+        if (cb != nullptr)
         {
-            // 2. 找到空闲块，在内存位图中将其置为 1
-            bitmap[byte_idx] |= (0x80 >> bit_idx);
-            // 3. 计算该位所在的物理块号并写回磁盘
-            // byte_idx / BLOCK_SIZE 得到该字节在位图区的第几个块 (0-7)
-            uint32_t bitmap_block_id = sb.bitmap_start + (byte_idx / BLOCK_SIZE);
-            // 获取该 512B 块在内存 vector 中的起始指针
-            uint32_t offset_in_bitmap = (byte_idx / BLOCK_SIZE) * BLOCK_SIZE;
-            char *block_ptr = reinterpret_cast<char *>(&bitmap[offset_in_bitmap]);
-            // 同步位图块到磁盘
-            if (!WriteBlock(bitmap_block_id, block_ptr))
+            // 其他线程正在装入这个块，等它读完
+            if (cb->loading)
             {
-                std::cerr << "错误：同步位图块到磁盘失败!" << std::endl;
-                return -1;
+                cacheCond.wait(lock);
+                continue;
             }
-            // 4. 更新内存中的超级块信息
-            sb.free_blocks--;
-            // 5. 同步超级块到磁盘 (Block 0)
-            if (!WriteBlock(0, reinterpret_cast<char *>(&sb)))
+            cacheStats.hits++;
+            return cb;
+        }
+        cacheStats.misses++;
+        cb = InsertCache(block_id);
+        if (cb == nullptr)
+            return nullptr;
+        // 装入中的槽位不会被淘汰，也不会被写入，解锁期间 cb 一直有效
+        cb->loading = true;
+        char *data = cb->data;
+        lock.unlock();
+        bool ok = device->Read(block_id, data);
+        lock.lock();
+        cb->loading = false;
+        cacheCond.notify_all();
+        if (!ok)
+        {
+            // 读取失败的槽位不能留在缓存中
+            DropCache(block_id);
+            return nullptr;
+        }
+        return cb;
+    }
+}
+
+// 从缓存中移除指定块（不写回，调用者持有 cacheMutex）
+void DiskManager::DropCache(uint32_t block_id)
+{
+    auto it = cacheIndex.find(block_id);
+    if (it == cacheIndex.end())
+        return;
+    cache.erase(it->second);
+    cacheIndex.erase(it);
+}
+
+// 将一个脏块写回磁盘（调用者持有 cacheMutex）
+// 块的新内容可能只在尚未刷新的日志里，写回原位置之前先刷新日志
+bool DiskManager::WriteBack(CacheBlock &cb)
+{
+    if (!FlushJournal())
+        return false;
+    if (!device->Write(cb.block_id, cb.data))
+    {
+        std::cerr << "错误：写回块 " << cb.block_id << " 失败!" << std::endl;
+        return false;
+    }
+    cb.dirty = false;
+    cacheStats.writebacks++;
+    cacheGeneration++;
+    return true;
+}
+
+// 清空块缓存和 Inode 缓存（不写回，调用前应先 Sync）
+void DiskManager::ClearCache()
+{
+    std::lock_guard<std::mutex> inodeGuard(inodeMutex);
+    std::lock_guard<std::mutex> cacheGuard(cacheMutex);
+    cache.clear();
+    cacheIndex.clear();
+    inodeCache.clear();
+}
+
+// 当前线程写入的块是否暂存进运行中的事务：持有事务句柄，或者正在为提交暂存超级块和脏 Inode
+bool DiskManager::InTransaction()
+{
+    return LocalState().depth > 0 || txnStager.load() == std::this_thread::get_id();
+}
+
+// 从运行中或正在提交的事务里拷贝出指定块，没有暂存时返回 false
+// 暂存的块是最新的内容，所有线程的读取都以它为准
+bool DiskManager::ReadStaged(uint32_t block_id, char *buffer)
+{
+    if (stagedCount == 0)
+        return false;
+    std::lock_guard<std::mutex> guard(stageMutex);
+    auto it = txnBlocks.find(block_id);
+    if (it == txnBlocks.end())
+    {
+        it = commitBlocks.find(block_id);
+        if (it == commitBlocks.end())
+            return false;
+    }
+    memcpy(buffer, it->second.get(), BLOCK_SIZE);
+    return true;
+}
+
+// 把块暂存进运行中的事务；缓冲区还被 PeekBlock 的调用者或正在提交的事务引用时换一块新的，交出去的内容不会被改写
+void DiskManager::StageBlock(uint32_t block_id, const char *buffer)
+{
+    std::lock_guard<std::mutex> guard(stageMutex);
+    std::shared_ptr<char[]> &slot = txnBlocks[block_id];
+    if (slot == nullptr || slot.use_count() > 1)
+        slot.reset(new char[BLOCK_SIZE]);
+    memcpy(slot.get(), buffer, BLOCK_SIZE);
+    stagedCount = txnBlocks.size() + commitBlocks.size();
+}
+
+// 读取指定块：暂存在事务中的块以暂存的内容为准；映射模式下从映射区拷贝，否则优先从缓存中获取
+bool DiskManager::ReadBlock(uint32_t block_id, char *buffer)
+{
+    if (ReadStaged(block_id, buffer))
+        return true;
+    if (mapped)
+    {
+        std::shared_lock<std::shared_mutex> guard(mapLock);
+        return device->Read(block_id, buffer);
+    }
+    std::unique_lock<std::mutex> lock(cacheMutex);
+    CacheBlock *cb = AcquireBlock(block_id, lock);
+    if (cb == nullptr)
+        return false;
+    memcpy(buffer, cb->data, BLOCK_SIZE);
+    return true;
+}
+
+// 写入指定块：事务句柄内只暂存进运行中的事务，提交并写入日志后才进入缓存；否则直接写入映射区或缓存
+bool DiskManager::WriteBlock(uint32_t block_id, char *buffer)
+{
+    if (readOnly)
+    {
+        std::cerr << "错误：镜像以只读方式挂载，不能写入块 " << block_id << "!" << std::endl;
+        return false;
+    }
+    if (InTransaction())
+    {
+        StageBlock(block_id, buffer);
+        return true;
+    }
+    return StoreBlock(block_id, buffer);
+}
+
+// 不经过事务写入指定块：映射模式下直接写入映射区；否则只写入缓存并标记为脏，由淘汰、Sync 或 UnMount 负责写回
+bool DiskManager::StoreBlock(uint32_t block_id, const char *buffer)
+{
+    if (mapped)
+    {
+        std::unique_lock<std::shared_mutex> guard(mapLock);
+        return device->Write(block_id, buffer);
+    }
+    std::unique_lock<std::mutex> lock(cacheMutex);
+    CacheBlock *cb = LookupCache(block_id);
+    // 整块覆盖无需读出旧内容，但要等正在进行的装入结束，避免旧内容盖掉新写入的数据
+    while (cb != nullptr && cb->loading)
+    {
+        cacheCond.wait(lock);
+        cb = LookupCache(block_id);
+    }
+    if (cb == nullptr)
+    {
+        cb = InsertCache(block_id);
+        if (cb == nullptr)
+            return false;
+    }
+    // 其他线程还在通过 PeekBlock 返回的指针读这个缓冲区时换一块新的
+    if (cb->buffer.use_count() > 1)
+    {
+        cb->buffer.reset(new char[BLOCK_SIZE]);
+        cb->data = cb->buffer.get();
+    }
+    memcpy(cb->data, buffer, BLOCK_SIZE);
+    cb->dirty = true;
+    return true;
+}
+
+// 只读访问指定块：返回暂存缓冲区或缓存槽位的地址，不拷贝；映射区随时可能被提交改写，映射模式下拷贝一份
+// 每个线程保留最近 PEEK_WINDOW 个缓冲区的引用，返回的指针在本线程之后的 PEEK_WINDOW 次 PeekBlock 内有效，内容不会被其他线程改写
+const char *DiskManager::PeekBlock(uint32_t block_id)
+{
+    static thread_local std::shared_ptr<char[]> recentPeeks[PEEK_WINDOW];
+    static thread_local unsigned nextPeek = 0;
+    std::shared_ptr<char[]> &slot = recentPeeks[nextPeek++ % PEEK_WINDOW];
+    if (stagedCount > 0)
+    {
+        std::lock_guard<std::mutex> guard(stageMutex);
+        auto it = txnBlocks.find(block_id);
+        if (it != txnBlocks.end() || (it = commitBlocks.find(block_id)) != commitBlocks.end())
+        {
+            slot = it->second;
+            return slot.get();
+        }
+    }
+    if (mapped)
+    {
+        if (slot == nullptr || slot.use_count() > 1)
+            slot.reset(new char[BLOCK_SIZE]);
+        std::shared_lock<std::shared_mutex> guard(mapLock);
+        return device->Read(block_id, slot.get()) ? slot.get() : nullptr;
+    }
+    std::unique_lock<std::mutex> lock(cacheMutex);
+    CacheBlock *cb = AcquireBlock(block_id, lock);
+    if (cb == nullptr)
+        return nullptr;
+    slot = cb->buffer;
+    return cb->data;
+}
+
+// 开始一个异步批次：后端的提交队列从本线程第一次提交起归本线程所有，直到 Wait
+void DiskManager::BeginBatch()
+{
+    if (batchOwner.load() == std::this_thread::get_id())
+        return;
+    batchMutex.lock();
+    batchOwner = std::this_thread::get_id();
+    std::lock_guard<std::mutex> guard(cacheMutex);
+    batchGeneration = cacheGeneration;
+}
+
+// 异步读取指定块：缓存命中时立即完成，否则交给后端排队，Wait 返回后 buffer 才有效
+bool DiskManager::SubmitRead(uint32_t block_id, char *buffer)
+{
+    if (ReadStaged(block_id, buffer))
+        return true;
+    if (mapped)
+    {
+        std::shared_lock<std::shared_mutex> guard(mapLock);
+        return device->Read(block_id, buffer);
+    }
+    {
+        std::lock_guard<std::mutex> guard(cacheMutex);
+        CacheBlock *cb = LookupCache(block_id);
+        if (cb != nullptr && !cb->loading)
+        {
+            cacheStats.hits++;
+            memcpy(buffer, cb->data, BLOCK_SIZE);
+            return true;
+        }
+        cacheStats.misses++;
+    }
+    BeginBatch();
+    if (!device->SubmitRead(block_id, buffer))
+        return false;
+    pendingReads.push_back({block_id, buffer});
+    return true;
+}
+
+// 异步写入文件数据块（ordered 模式）：数据不进日志，直接交给后端写到原位置，Wait 返回后完成，buffer 在此之前必须保持有效
+// 提交事务时先让这些数据落盘，再写元数据的日志记录，已提交的元数据不会指向没写完的数据；
+// 覆盖已有的块是原地改写，崩溃后这些块可能是新旧内容的混合。以下情况仍按 WriteBlock 写进事务：
+// 不在事务中；事务要求数据也写进日志；块已经暂存在事务里，重放日志会改写它，或者释放它的事务还没有持久（见 NeedsJournal）
+bool DiskManager::SubmitWrite(uint32_t block_id, char *buffer)
+{
+    if (readOnly || !InTransaction() || LocalState().journalData || NeedsJournal(block_id))
+        return WriteBlock(block_id, buffer);
+    txnOrdered = true;
+    if (mapped)
+    {
+        std::unique_lock<std::shared_mutex> guard(mapLock);
+        return device->Write(block_id, buffer);
+    }
+    {
+        // 缓存中的副本同步更新；正在写回的块保持为脏，由下一轮写回用新内容再写一次
+        std::unique_lock<std::mutex> lock(cacheMutex);
+        CacheBlock *cb = LookupCache(block_id);
+        while (cb != nullptr && cb->loading)
+        {
+            cacheCond.wait(lock);
+            cb = LookupCache(block_id);
+        }
+        if (cb != nullptr)
+        {
+            if (cb->buffer.use_count() > 1)
             {
-                std::cerr << "错误：同步超级块到磁盘失败!" << std::endl;
-                return -1;
+                cb->buffer.reset(new char[BLOCK_SIZE]);
+                cb->data = cb->buffer.get();
             }
-            // 6. 返回成功分配的物理块号
-            return i;
+            memcpy(cb->data, buffer, BLOCK_SIZE);
+            cb->dirty = cb->flushing;
+        }
+        // 其他线程此前提交、还没完成的读可能读到旧内容，不能放入缓存
+        cacheGeneration++;
+    }
+    BeginBatch();
+    return device->SubmitWrite(block_id, buffer);
+}
+
+// 这个块的新内容是否必须写进日志：它暂存在运行中或正在提交的事务里；上次检查点之后它出现在日志里（重放时会被旧内容覆盖）；
+// 或者释放它的事务还没有持久（崩溃后它仍属于原来的文件，原地写会破坏那个文件）
+bool DiskManager::NeedsJournal(uint32_t block_id)
+{
+    if (stagedCount > 0)
+    {
+        std::lock_guard<std::mutex> guard(stageMutex);
+        if (txnBlocks.count(block_id) != 0 || commitBlocks.count(block_id) != 0)
+            return true;
+    }
+    std::lock_guard<std::mutex> guard(reuseMutex);
+    return journaledBlocks.count(block_id) != 0 || freedBlocks.count(block_id) != 0;
+}
+
+// 等待本线程提交的所有请求完成，并把读到的块放入缓存，然后交还批次
+bool DiskManager::Wait()
+{
+    if (batchOwner.load() != std::this_thread::get_id())
+        return true;
+    bool ok = device->Wait();
+    {
+        std::lock_guard<std::mutex> guard(cacheMutex);
+        // 批次期间有块写回过磁盘时，读到的内容可能已经过期，不放入缓存
+        for (const PendingRead &req : pendingReads)
+        {
+            // 等待期间已被放入缓存的块以缓存为准
+            if (!ok || cacheGeneration != batchGeneration || cacheIndex.count(req.block_id) != 0)
+                continue;
+            CacheBlock *cb = InsertCache(req.block_id);
+            if (cb != nullptr)
+                memcpy(cb->data, req.buffer, BLOCK_SIZE);
+        }
+    }
+    pendingReads.clear();
+    batchOwner = std::thread::id();
+    batchMutex.unlock();
+    return ok;
+}
+
+// 提交运行中的事务（连同事务之外修改的超级块和脏 Inode），再写回缓存中的所有脏块并刷新，然后清空日志（检查点）
+// 持有事务句柄的线程不能等待提交（提交要等它的句柄关闭），只写回已经提交的块
+bool DiskManager::Sync()
+{
+    if (!device->IsOpen())
+        return false;
+    if (readOnly)
+        return true;
+    if (LocalState().depth > 0)
+        return WriteBackDirty();
+    std::lock_guard<std::mutex> guard(commitMutex);
+    bool ok = CommitRunning();
+    return Checkpoint(committedSeq) && ok;
+}
+
+// 检查点（调用者持有 commitMutex）：已提交事务的块都已在缓存中，全部写回原位置后日志可以清空；
+// 序号不大于 durableSeq 的事务至此全部持久，它们释放的块可以原地写入
+bool DiskManager::Checkpoint(uint64_t durableSeq)
+{
+    bool ok = WriteBackDirty();
+    if (ok && JournalEnabled() && journalHead > 1)
+        ok = ResetJournal();
+    if (ok)
+    {
+        std::lock_guard<std::mutex> guard(reuseMutex);
+        for (auto it = freedBlocks.begin(); it != freedBlocks.end();)
+            it = (it->second <= durableSeq) ? freedBlocks.erase(it) : std::next(it);
+    }
+    return ok;
+}
+
+// 将缓存中的所有脏块按块号顺序写回磁盘并刷新，相邻的脏块合并为一次向量写
+// 脏块在缓存锁内拷贝出来并标记为写回中，磁盘写不持有缓存锁，其他线程的读写照常进行
+// 事务的块在日志写入之后才进入缓存，取出副本后再刷新日志就可以写回，不需要事务锁
+bool DiskManager::WriteBackDirty()
+{
+    std::lock_guard<std::mutex> writebackGuard(writebackMutex);
+    // 1. 取出所有脏块的副本，按块号排序，让写回尽量顺序进行
+    std::vector<CacheBlock *> dirtyBlocks;
+    std::vector<char> copies;
+    {
+        std::lock_guard<std::mutex> guard(cacheMutex);
+        for (auto &cb : cache)
+            if (cb.dirty)
+                dirtyBlocks.push_back(&cb);
+        std::sort(dirtyBlocks.begin(), dirtyBlocks.end(), [](const CacheBlock *a, const CacheBlock *b)
+                  { return a->block_id < b->block_id; });
+        copies.resize(dirtyBlocks.size() * BLOCK_SIZE);
+        for (size_t i = 0; i < dirtyBlocks.size(); ++i)
+        {
+            memcpy(&copies[i * BLOCK_SIZE], dirtyBlocks[i]->data, BLOCK_SIZE);
+            // 写回期间再被写入的块会重新变脏，留给下一次 Sync
+            dirtyBlocks[i]->dirty = false;
+            dirtyBlocks[i]->flushing = true;
+        }
+    }
+    // 2. 刷新日志后写回副本：孤立的块交给后端批量提交，连续的一段用一次向量写
+    // 日志刷新失败时一个块也不写，全部留待下一次写回
+    bool ok = FlushJournal();
+    std::vector<char> written(dirtyBlocks.size(), 0);
+    std::vector<size_t> submitted; // 单独提交给异步后端的块
+    std::vector<const char *> run;
+    BeginBatch();
+    for (size_t i = 0; ok && i < dirtyBlocks.size();)
+    {
+        // 找出从 i 开始块号连续的一段
+        size_t j = i + 1;
+        while (j < dirtyBlocks.size() && dirtyBlocks[j]->block_id == dirtyBlocks[j - 1]->block_id + 1)
+            ++j;
+        if (j == i + 1 && device->SubmitWrite(dirtyBlocks[i]->block_id, &copies[i * BLOCK_SIZE]))
+        {
+            submitted.push_back(i);
+            i = j;
+            continue;
+        }
+        run.clear();
+        for (size_t k = i; k < j; ++k)
+            run.push_back(&copies[k * BLOCK_SIZE]);
+        if (device->WriteRange(dirtyBlocks[i]->block_id, run.data(), run.size()))
+            std::fill(written.begin() + i, written.begin() + j, 1);
+        else
+        {
+            std::cerr << "错误：写回块 " << dirtyBlocks[i]->block_id << " 起的 " << j - i << " 个块失败!" << std::endl;
+            ok = false;
+        }
+        i = j;
+    }
+    if (Wait())
+    {
+        for (size_t i : submitted)
+            written[i] = 1;
+    }
+    else
+    {
+        std::cerr << "错误：批量写回缓存块失败!" << std::endl;
+        ok = false;
+    }
+    // 3. 写回结束：失败的块重新标记为脏
+    {
+        std::lock_guard<std::mutex> guard(cacheMutex);
+        for (size_t i = 0; i < dirtyBlocks.size(); ++i)
+        {
+            dirtyBlocks[i]->flushing = false;
+            if (written[i])
+                cacheStats.writebacks++;
+            else
+                dirtyBlocks[i]->dirty = true;
+        }
+        cacheGeneration++;
+    }
+    return device->Flush() && ok;
+}
+
+// 让所有已提交的事务持久：日志中有尚未刷新的记录时刷新一次设备
+// 事务的块都在日志里，刷新日志之后即使原位置还没有写回，重新挂载时也能重放出来
+bool DiskManager::FlushJournal()
+{
+    std::lock_guard<std::mutex> guard(journalFlushMutex);
+    if (!journalUnflushed.exchange(false))
+        return true;
+    // 此时已经写好记录的事务，刷新之后都持久，它们释放的块可以原地写入
+    uint64_t durableSeq;
+    {
+        std::lock_guard<std::mutex> reuseGuard(reuseMutex);
+        durableSeq = journaledSeq;
+    }
+    if (!device->Flush())
+    {
+        journalUnflushed = true;
+        std::cerr << "错误：刷新日志失败!" << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> reuseGuard(reuseMutex);
+    for (auto it = freedBlocks.begin(); it != freedBlocks.end();)
+        it = (it->second <= durableSeq) ? freedBlocks.erase(it) : std::next(it);
+    return true;
+}
+
+// 设置持久化策略，须在挂载之前调用；映射模式和没有日志的镜像每次提交仍然立即持久
+void DiskManager::SetDurability(DurabilityPolicy policy, uint32_t intervalMs)
+{
+    durability = policy;
+    flushIntervalMs = (intervalMs > 0) ? intervalMs : FLUSH_INTERVAL_MS;
+}
+
+DurabilityPolicy DiskManager::GetDurability() const
+{
+    return durability;
+}
+
+// 后台写回线程：每隔 flushIntervalMs 先写回大部分脏块，再用一次 Sync 提交运行中的事务、补齐剩下的并清空日志
+// 新句柄只在 Sync 封闭事务的片刻等待，日志也很少在提交路径上写满
+void DiskManager::FlusherLoop()
+{
+    std::unique_lock<std::mutex> lock(flusherMutex);
+    while (!flusherStop)
+    {
+        flusherCond.wait_for(lock, std::chrono::milliseconds(flushIntervalMs));
+        if (flusherStop)
+            break;
+        lock.unlock();
+        if (!WriteBackDirty() || !Sync())
+            std::cerr << "错误：后台写回失败!" << std::endl;
+        lock.lock();
+    }
+}
+
+// 通知后台写回线程退出并等待它结束
+void DiskManager::StopFlusher()
+{
+    if (!flusher.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> guard(flusherMutex);
+        flusherStop = true;
+    }
+    flusherCond.notify_all();
+    flusher.join();
+}
+
+// 开启事务句柄：之后本线程写入的块暂存进运行中的事务，直到最外层的 CommitTransaction
+// 各线程的句柄并入同一个事务，互不等待；提交者正在封闭事务，或者估计运行中的事务放不下这个句柄时，等它换上下一个事务
+// 同一线程内可以嵌套，任何一层要求写日志的数据，整个句柄的数据都写进日志；journalBlocks 是要写进日志的数据块数
+void DiskManager::BeginTransaction(uint32_t journalBlocks)
+{
+    ThreadState &state = LocalState();
+    if (journalBlocks > 0)
+        state.journalData = true;
+    if (state.depth > 0)
+    {
+        state.depth++;
+        return;
+    }
+    uint32_t budget = TXN_META_BLOCKS + journalBlocks;
+    std::unique_lock<std::mutex> lock(txnMutex);
+    while (true)
+    {
+        txnCond.wait(lock, [this]() { return !txnSealing; });
+        uint32_t staged;
+        {
+            std::lock_guard<std::mutex> guard(stageMutex);
+            staged = txnBlocks.size();
+        }
+        if (staged + txnBudget + budget <= TxnCapacity() || (txnHandles == 0 && staged == 0))
+            break;
+        if (txnHandles > 0)
+        {
+            // 已开启的句柄关闭时会提交，之后再判断
+            txnCond.wait(lock);
+            continue;
+        }
+        // 没有句柄却积攒了放不下的暂存块（事务之外写回的 Inode 等），先把它们提交掉
+        uint64_t seq = txnSeq;
+        lock.unlock();
+        CommitThrough(seq);
+        lock.lock();
+    }
+    txnHandles++;
+    txnBudget += budget;
+    state.depth = 1;
+    state.budget = budget;
+    state.seq = txnSeq;
+}
+
+// 关闭事务句柄：最外层关闭后，本线程所在的事务如果还没有被其他线程一并提交，就由本线程提交
+bool DiskManager::CommitTransaction()
+{
+    ThreadState &state = LocalState();
+    if (state.depth == 0)
+        return false;
+    if (--state.depth > 0)
+        return true;
+    state.journalData = false;
+    {
+        std::lock_guard<std::mutex> guard(txnMutex);
+        txnHandles--;
+        txnBudget -= state.budget;
+    }
+    txnCond.notify_all();
+    return CommitThrough(state.seq);
+}
+
+// 一条日志记录最多能容纳的块数，运行中的事务按它估算还能并入多少句柄
+uint32_t DiskManager::TxnCapacity() const
+{
+    if (!JournalEnabled())
+        return UINT32_MAX;
+    return std::min<uint32_t>(JOURNAL_DESC_CAPACITY, sb.journal_blocks - 3);
+}
+
+// 提交序号不大于 seq 的事务：排队等待提交锁期间，其他线程可能已经把它一起提交了（组提交）
+bool DiskManager::CommitThrough(uint64_t seq)
+{
+    std::lock_guard<std::mutex> guard(commitMutex);
+    if (committedSeq >= seq)
+        return failedSeq != seq;
+    return CommitRunning();
+}
+
+// 提交运行中的事务（调用者持有 commitMutex）：事务锁只在封闭和换新时短暂持有，
+// 写日志、写回原位置等 I/O 期间新的句柄照常开启，写入下一个事务
+bool DiskManager::CommitRunning()
+{
+    // 1. 封闭运行中的事务：新句柄等待，已开启的句柄全部关闭后，把超级块和脏 Inode 暂存进来
+    std::unique_lock<std::mutex> lock(txnMutex);
+    txnCond.wait(lock, [this]() { return !txnSealing; });
+    txnSealing = true;
+    txnCond.wait(lock, [this]() { return txnHandles == 0; });
+    lock.unlock();
+    txnStager = std::this_thread::get_id();
+    bool ok = FlushSuperBlock();
+    {
+        std::lock_guard<std::mutex> guard(inodeMutex);
+        ok = FlushInodes() && ok;
+    }
+    txnStager = std::thread::id();
+    // 2. 换上下一个事务：暂存的块转为正在提交，读者在它们进入缓存之前仍从这里读到
+    lock.lock();
+    uint64_t seq = txnSeq++;
+    bool ordered = txnOrdered.exchange(false);
+    {
+        std::lock_guard<std::mutex> guard(stageMutex);
+        commitBlocks.swap(txnBlocks);
+    }
+    txnSealing = false;
+    lock.unlock();
+    txnCond.notify_all();
+    // 3. 直接写到原位置的文件数据先落盘，再写引用它们的元数据记录；
+    // 其他策略下数据和记录由同一次刷新持久，不保证先后，崩溃后新分配的块里可能是旧内容
+    if (ordered && (durability == DURABILITY_ALWAYS || mapped) && !device->Flush())
+    {
+        std::cerr << "错误：刷新文件数据失败!" << std::endl;
+        ok = false;
+    }
+    if (!commitBlocks.empty())
+    {
+        // 4. 先顺序写日志，之后这些块才允许写回原位置
+        bool journaled = JournalEnabled() && WriteJournal(seq);
+        // 5. 把事务中的块交给缓存（或映射区），由正常的写回路径落到原位置；进入缓存之后才不再算作暂存
+        for (auto &item : commitBlocks)
+            if (!StoreBlock(item.first, item.second.get()))
+                ok = false;
+        {
+            std::lock_guard<std::mutex> guard(stageMutex);
+            commitBlocks.clear();
+            stagedCount = txnBlocks.size();
         }
+        // 6. 没有日志或事务放不进一条记录时，退化为立即写回原位置
+        if (!journaled)
+            ok = Checkpoint(seq) && ok;
+    }
+    committedSeq = seq;
+    if (!ok)
+        failedSeq = seq;
+    return ok;
+}
+
+// 镜像是否带有日志区
+bool DiskManager::JournalEnabled() const
+{
+    return sb.journal_blocks > 2 && sb.journal_start + sb.journal_blocks <= sb.data_start;
+}
+
+// 将正在提交的事务写成一条日志记录：描述块 + 各数据块 + 提交块，一次向量写加一次刷新（调用者持有 commitMutex）
+bool DiskManager::WriteJournal(uint64_t seq)
+{
+    uint32_t count = commitBlocks.size();
+    // 日志区第 0 块是日志头，单条记录必须能放进剩余部分
+    if (count > JOURNAL_DESC_CAPACITY || count + 2 > sb.journal_blocks - 1)
+        return false;
+    // 1. 剩余空间不足时先做检查点：写回所有已提交的块，日志从头开始
+    if (journalHead + count + 2 > sb.journal_blocks && !Checkpoint(committedSeq))
+        return false;
+    // 2. 组装描述块、数据块和提交块
+    JournalDescriptor desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.magic = JOURNAL_DESC_MAGIC;
+    desc.sequence = journalSeq;
+    desc.count = count;
+    std::vector<const char *> record;
+    record.push_back(reinterpret_cast<const char *>(&desc));
+    for (auto &item : commitBlocks)
+    {
+        desc.block_ids[record.size() - 1] = item.first;
+        record.push_back(item.second.get());
+    }
+    JournalCommit commit;
+    memset(&commit, 0, sizeof(commit));
+    commit.magic = JOURNAL_COMMIT_MAGIC;
+    commit.sequence = journalSeq;
+    commit.checksum = JournalChecksum(desc, std::vector<const char *>(record.begin() + 1, record.end()));
+    record.push_back(reinterpret_cast<const char *>(&commit));
+    // 3. 整条记录顺序写入；每次提交都持久的策略下立即刷新，刷新返回后事务即为持久
+    // 其他策略只记下日志未刷新，由后台线程、sync/fsync 或写回原位置之前统一刷新
+    // 映射模式下块在提交时就直接写进映射区，随时可能被系统写回，日志必须先刷新
+    if (!device->WriteRange(sb.journal_start + journalHead, record.data(), record.size()))
+    {
+        std::cerr << "错误：写入日志失败!" << std::endl;
+        return false;
+    }
+    // 4. 记下重放时会改写的块，之后写文件数据时这些块仍要进日志；本事务释放的块在刷新之后才能原地写入
+    {
+        std::lock_guard<std::mutex> reuseGuard(reuseMutex);
+        for (auto &item : commitBlocks)
+            journaledBlocks.insert(item.first);
+        journaledSeq = seq;
+    }
+    journalUnflushed = true;
+    if ((durability == DURABILITY_ALWAYS || mapped) && !FlushJournal())
+        return false;
+    journalHead += count + 2;
+    journalSeq++;
+    return true;
+}
+
+// 挂载时重放日志：从日志头记录的位置起依次校验并重放完整提交的事务，遇到不完整的记录即停止
+bool DiskManager::ReplayJournal()
+{
+    JournalHeader header;
+    if (!device->Read(sb.journal_start, reinterpret_cast<char *>(&header)))
+        return false;
+    // 日志头无效（新格式化的镜像）时直接初始化日志
+    if (header.magic != JOURNAL_HEADER_MAGIC)
+    {
+        journalSeq = 1;
+        return ResetJournal();
+    }
+    uint32_t seq = header.sequence;
+    uint32_t pos = (header.start >= 1) ? header.start : 1;
+    uint32_t replayed = 0;
+    JournalDescriptor desc;
+    JournalCommit commit;
+    std::vector<char> data;
+    while (pos + 2 <= sb.journal_blocks)
+    {
+        // 1. 描述块必须是下一个序号的事务
+        if (!device->Read(sb.journal_start + pos, reinterpret_cast<char *>(&desc)))
+            break;
+        if (desc.magic != JOURNAL_DESC_MAGIC || desc.sequence != seq || desc.count == 0 ||
+            desc.count > JOURNAL_DESC_CAPACITY || pos + desc.count + 2 > sb.journal_blocks)
+            break;
+        // 2. 读出数据块和提交块，校验和不符说明该事务没有写完
+        data.resize(desc.count * BLOCK_SIZE);
+        if (!device->ReadRange(sb.journal_start + pos + 1, data.data(), desc.count) ||
+            !device->Read(sb.journal_start + pos + 1 + desc.count, reinterpret_cast<char *>(&commit)))
+            break;
+        std::vector<const char *> blocks;
+        for (uint32_t i = 0; i < desc.count; ++i)
+            blocks.push_back(data.data() + i * BLOCK_SIZE);
+        if (commit.magic != JOURNAL_COMMIT_MAGIC || commit.sequence != seq ||
+            commit.checksum != JournalChecksum(desc, blocks))
+            break;
+        // 3. 把事务中的块写回原位置
+        for (uint32_t i = 0; i < desc.count; ++i)
+            if (!device->Write(desc.block_ids[i], blocks[i]))
+                return false;
+        pos += desc.count + 2;
+        seq++;
+        replayed++;
+    }
+    if (replayed > 0)
+    {
+        if (!device->Flush())
+            return false;
+        std::cout << "日志恢复：重放了 " << replayed << " 个事务" << std::endl;
+    }
+    // 4. 重放完成后清空日志，新的事务从下一个序号继续
+    journalSeq = seq;
+    return ResetJournal();
+}
+
+// 清空日志：日志头指向日志区开头，旧记录因序号不匹配而失效
+bool DiskManager::ResetJournal()
+{
+    JournalHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = JOURNAL_HEADER_MAGIC;
+    header.sequence = journalSeq;
+    header.start = 1;
+    if (!device->Write(sb.journal_start, reinterpret_cast<const char *>(&header)) || !device->Flush())
+    {
+        std::cerr << "错误：写入日志头失败!" << std::endl;
+        return false;
     }
-    // 如果遍历完所有块都没有找到 0
-    std::cerr << "错误：没有可用的物理块!" << std::endl;
+    journalHead = 1;
+    // 日志中的记录全部失效，重放不会再改写任何块
+    std::lock_guard<std::mutex> reuseGuard(reuseMutex);
+    journaledBlocks.clear();
+    return true;
+}
+
+// 日志记录的校验和（FNV-1a），覆盖目标块号和全部数据块
+uint32_t DiskManager::JournalChecksum(const JournalDescriptor &desc, const std::vector<const char *> &blocks)
+{
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](const char *p, size_t len)
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            hash ^= (uint8_t)p[i];
+            hash *= 16777619u;
+        }
+    };
+    mix(reinterpret_cast<const char *>(desc.block_ids), desc.count * sizeof(uint32_t));
+    for (const char *block : blocks)
+        mix(block, BLOCK_SIZE);
+    return hash;
+}
+
+// 获取缓存统计信息
+CacheStats DiskManager::GetCacheStats()
+{
+    std::lock_guard<std::mutex> guard(cacheMutex);
+    return cacheStats;
+}
+
+// 获取 Inode 缓存统计信息
+CacheStats DiskManager::GetInodeCacheStats()
+{
+    std::lock_guard<std::mutex> guard(inodeMutex);
+    return inodeStats;
+}
+
+// 在位图 bits 的 [start, end) 位范围内查找第一个值等于 set 的位，找不到返回 -1
+// 位图在字节内从高位向低位排列，因此按大端序装入 64 位字后用前导零计数定位
+int64_t DiskManager::FindBit(const uint8_t *bits, uint32_t start, uint32_t end, bool set)
+{
+    // 查找 0 位时把数据取反，统一成查找 1 位
+    const uint64_t flip = set ? 0 : ~0ULL;
+    uint32_t pos = start;
+    // 1. 逐位处理到 8 位对齐
+    while (pos < end && (pos % 8) != 0)
+    {
+        if (((bits[pos / 8] & (0x80 >> (pos % 8))) != 0) == set)
+            return pos;
+        ++pos;
+    }
+#ifdef __AVX2__
+    // 2. AVX2：一次比较 32 字节，整段都不含目标位（256 个块）直接跳过
+    const __m256i skipPattern = _mm256_set1_epi8((char)(set ? 0x00 : 0xFF));
+    while (pos + 256 <= end)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bits + pos / 8));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, skipPattern)) != -1)
+            break;
+        pos += 256;
+    }
+#endif
+    // 3. 一次检查 64 位，跳过不含目标位的字
+    while (pos + 64 <= end)
+    {
+        uint64_t word;
+        memcpy(&word, bits + pos / 8, sizeof(word));
+        word = __builtin_bswap64(word) ^ flip;
+        if (word != 0)
+            return pos + __builtin_clzll(word);
+        pos += 64;
+    }
+    // 4. 处理末尾不足 64 位的部分
+    for (; pos < end; ++pos)
+        if (((bits[pos / 8] & (0x80 >> (pos % 8))) != 0) == set)
+            return pos;
     return -1;
 }
 
+// 将位图中 [start, start + count) 的位设置为 value（调用者持有对应分配组的锁）
+// 整个 64 位字一次原子写入，零散的位按字节原子修改，相邻分配组共用的字节和不加锁读取位图的线程（位图块写回）都不会看到撕裂的数据
+void DiskManager::SetBitRange(uint32_t start, uint32_t count, bool value)
+{
+    uint32_t pos = start, end = start + count;
+    while (pos < end)
+    {
+        if (pos % 64 == 0 && end - pos >= 64)
+        {
+            __atomic_store_n(reinterpret_cast<uint64_t *>(&bitmap[pos / 8]), value ? ~0ULL : 0ULL, __ATOMIC_RELAXED);
+            pos += 64;
+            continue;
+        }
+        uint32_t bits = std::min(8 - pos % 8, end - pos);
+        uint8_t mask = (uint8_t)((0xFF >> (pos % 8)) & (0xFF << (8 - pos % 8 - bits)));
+        if (value)
+            __atomic_fetch_or(&bitmap[pos / 8], mask, __ATOMIC_RELAXED);
+        else
+            __atomic_fetch_and(&bitmap[pos / 8], (uint8_t)~mask, __ATOMIC_RELAXED);
+        pos += bits;
+    }
+}
+
+// 将覆盖 [start, start + count) 位的每个位图块各写回一次（位号从整个位图区的开头算起）
+// 其他线程可能同时在修改同一块中别的位，按字节原子读取出副本；每个线程改完位之后都会再写一次，事务里最后的副本包含所有修改
+bool DiskManager::SyncBitmapRange(uint32_t start, uint32_t count)
+{
+    uint32_t firstBlock = (start / 8) / BLOCK_SIZE;
+    uint32_t lastBlock = ((start + count - 1) / 8) / BLOCK_SIZE;
+    char buffer[BLOCK_SIZE];
+    for (uint32_t b = firstBlock; b <= lastBlock; ++b)
+    {
+        for (uint32_t i = 0; i < BLOCK_SIZE; ++i)
+            buffer[i] = (char)__atomic_load_n(&bitmap[b * BLOCK_SIZE + i], __ATOMIC_RELAXED);
+        if (!WriteBlock(sb.bitmap_start + b, buffer))
+            return false;
+    }
+    return true;
+}
+
+// 标记超级块需要写出：已经是脏的就不再写这个所有线程共用的标记
+void DiskManager::MarkSuperBlockDirty()
+{
+    if (!sbDirty.load())
+        sbDirty = true;
+}
+
+// 把超级块的修改写出：分配和释放只修改各组的空闲计数和游标，事务提交和 Sync 时汇总后统一写一次
+bool DiskManager::FlushSuperBlock()
+{
+    if (!sbDirty.exchange(false))
+        return true;
+    SuperBlock copy;
+    memcpy(&copy, &sb, sizeof(SuperBlock));
+    copy.free_blocks = 0;
+    for (auto &grp : groups)
+        copy.free_blocks += grp->free_blocks;
+    // 游标取自最近分配所在的组
+    if (!groups.empty())
+    {
+        AllocGroup &blockGroup = *groups[lastBlockGroup];
+        AllocGroup &inodeGroup = *groups[lastInodeGroup];
+        {
+            std::lock_guard<std::mutex> guard(blockGroup.blockMutex);
+            copy.next_free_block = blockGroup.next_block;
+        }
+        std::lock_guard<std::mutex> guard(inodeGroup.inodeMutex);
+        copy.next_free_inode = inodeGroup.next_inode;
+    }
+    if (!WriteBlock(0, reinterpret_cast<char *>(&copy)))
+    {
+        std::cerr << "错误：同步超级块到磁盘失败!" << std::endl;
+        sbDirty = true;
+        return false;
+    }
+    return true;
+}
+
+// 挂载时根据位图划分分配组：数据区按 GROUP_BLOCKS 对齐分组，第一组从数据区起始处开始，
+// Inode 编号平均分给各组，每组的 Inode 数取 64 的倍数，保证不同组不会在同一个位图字里查找
+void DiskManager::BuildGroups()
+{
+    groups.clear();
+    groupBase = sb.data_start / GROUP_BLOCKS;
+    for (uint32_t start = groupBase * GROUP_BLOCKS; start < sb.total_blocks; start += GROUP_BLOCKS)
+    {
+        std::unique_ptr<AllocGroup> grp(new AllocGroup());
+        grp->first_block = std::max(start, sb.data_start);
+        grp->end_block = std::min(start + GROUP_BLOCKS, sb.total_blocks);
+        grp->next_block = grp->first_block;
+        grp->tree.Build(bitmap, grp->first_block, grp->end_block);
+        grp->free_blocks = grp->tree.FreeCount();
+        groups.push_back(std::move(grp));
+    }
+    uint32_t n = groups.size();
+    inodesPerGroup = ((sb.inode_count + n - 1) / n + 63) / 64 * 64;
+    const uint8_t *inodeBits = bitmap + sb.inode_bitmap_offset;
+    for (uint32_t g = 0; g < n; ++g)
+    {
+        AllocGroup &grp = *groups[g];
+        grp.first_inode = std::min(g * inodesPerGroup, sb.inode_count);
+        grp.end_inode = std::min(grp.first_inode + inodesPerGroup, sb.inode_count);
+        grp.next_inode = grp.first_inode;
+        uint32_t freeInodes = 0;
+        for (uint32_t id = grp.first_inode; id < grp.end_inode; ++id)
+            if (!(inodeBits[id / 8] & (0x80 >> (id % 8))))
+                freeInodes++;
+        grp.free_inodes = freeInodes;
+    }
+    // 恢复超级块中持久化的游标：最近分配所在的组从上次的位置继续，线程的首选组也从这一组排起
+    // 旧镜像中游标为 0 或越界时各组都从头开始
+    groupSeed = 0;
+    lastInodeGroup = 0;
+    if (sb.next_free_block >= sb.data_start && sb.next_free_block < sb.total_blocks)
+    {
+        groupSeed = GroupOfBlock(sb.next_free_block);
+        groups[groupSeed]->next_block = sb.next_free_block;
+    }
+    lastBlockGroup = groupSeed;
+    if (sb.next_free_inode < sb.inode_count)
+    {
+        lastInodeGroup = std::min(GroupOfInode(sb.next_free_inode), n - 1);
+        groups[lastInodeGroup]->next_inode = sb.next_free_inode;
+    }
+    int64_t freeBlocks = 0;
+    for (auto &grp : groups)
+        freeBlocks += grp->free_blocks;
+    availBlocks = freeBlocks;
+}
+
+// 块所在的分配组
+uint32_t DiskManager::GroupOfBlock(uint32_t block_id) const
+{
+    return block_id / GROUP_BLOCKS - groupBase;
+}
+
+// Inode 所在的分配组
+uint32_t DiskManager::GroupOfInode(uint32_t inode_id) const
+{
+    return inode_id / inodesPerGroup;
+}
+
+// 本线程的首选组：每个线程第一次分配时领一个编号，按编号轮流对应到各组，不同线程的分配尽量落在不同的组上
+uint32_t DiskManager::ThreadGroup() const
+{
+    static std::atomic<uint32_t> nextTicket{0};
+    static thread_local uint32_t ticket = nextTicket++;
+    return (ticket + groupSeed) % groups.size();
+}
+
+// 为新目录选组：从轮转起点开始，取第一个空闲块和空闲 Inode 都不少于平均值的组，让目录分散到各组
+uint32_t DiskManager::ChooseDirGroup()
+{
+    uint32_t n = groups.size();
+    uint64_t freeBlocks = 0, freeInodes = 0;
+    for (auto &grp : groups)
+    {
+        freeBlocks += grp->free_blocks;
+        freeInodes += grp->free_inodes;
+    }
+    uint32_t start = dirRotor++ % n;
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        AllocGroup &grp = *groups[(start + i) % n];
+        if (grp.free_inodes > 0 && (uint64_t)grp.free_inodes * n >= freeInodes && (uint64_t)grp.free_blocks * n >= freeBlocks)
+            return (start + i) % n;
+    }
+    return start;
+}
+
+// 文件数据块的分配起点：Inode 所在组的第一个数据块，让文件的数据与它的 Inode、所在目录放在同一组
+uint32_t DiskManager::GroupGoal(uint32_t inode_id)
+{
+    if (groups.empty())
+        return 0;
+    return groups[std::min(GroupOfInode(inode_id), (uint32_t)groups.size() - 1)]->first_block;
+}
+
+// 申请一个物理空闲块，返回物理块号，失败返回 -1
+int DiskManager::AllocateBlock()
+{
+    int found = AllocateExtent(1);
+    if (found < 0)
+        std::cerr << "错误：没有可用的物理块!" << std::endl;
+    return found;
+}
+
 // 释放指定的物理块
 bool DiskManager::FreeBlock(uint32_t block_id)
+{
+    return FreeExtent(block_id, 1);
+}
+
+// 本线程在这个磁盘管理器上的私有状态
+DiskManager::ThreadState &DiskManager::LocalState()
+{
+    static thread_local std::unordered_map<const DiskManager *, ThreadState> states;
+    return states[this];
+}
+
+// 从可分配的块数中扣除 count 块，不足时返回 false，其他线程预留的块不会被扣走
+bool DiskManager::TakeAvailable(uint32_t count)
+{
+    int64_t current = availBlocks.load();
+    do
+    {
+        if (current < count)
+            return false;
+    } while (!availBlocks.compare_exchange_weak(current, current - count));
+    return true;
+}
+
+// 为本线程预留 count 块：之后本线程的分配先用预留的块，其他线程的分配不会占用它们
+// 空间不足时返回 false，什么也不预留
+bool DiskManager::ReserveBlocks(uint32_t count)
+{
+    if (!TakeAvailable(count))
+        return false;
+    LocalState().reserved += count;
+    return true;
+}
+
+// 归还本线程没有用完的预留
+void DiskManager::ReleaseReservation()
+{
+    ThreadState &state = LocalState();
+    availBlocks += state.reserved;
+    state.reserved = 0;
+}
+
+// 申请 count 个连续的物理块，返回起始块号，失败返回 -1；连续段不跨分配组
+// 有 hint 时先在 hint 所在的组从 hint 处找，否则先在本线程的首选组从组游标处找，
+// 起始组放不下时依次尝试本线程的首选组和其余各组；位图块的写回在组锁之外进行
+int DiskManager::AllocateExtent(uint32_t count, uint32_t hint)
+{
+    if (count == 0 || groups.empty())
+        return -1;
+    // 先扣除可分配的块数：本线程有足够的预留时用预留，否则只能用没有被预留的块
+    ThreadState &state = LocalState();
+    bool reserved = state.reserved >= count;
+    if (reserved)
+        state.reserved -= count;
+    else if (!TakeAvailable(count))
+        return -1;
+    const uint32_t n = groups.size();
+    bool hinted = (hint >= sb.data_start && hint < sb.total_blocks);
+    uint32_t home = hinted ? GroupOfBlock(hint) : ThreadGroup();
+    uint32_t spill = ThreadGroup();
+    int64_t found = -1;
+    // 1. 查找顺序：起始组、首选组，然后从起始组之后依次轮一遍
+    for (uint32_t i = 0; i <= n && found < 0; ++i)
+    {
+        uint32_t g = (i == 0) ? home : (i == 1) ? spill : (home + i - 1) % n;
+        if ((i == 1 && g == home) || (i >= 2 && (g == home || g == spill)))
+            continue;
+        AllocGroup &grp = *groups[g];
+        if (grp.free_blocks < count)
+            continue;
+        std::lock_guard<std::mutex> guard(grp.blockMutex);
+        // 2. 通过摘要树从起点向后找，找不到再从组的起始处找
+        uint32_t from = (i == 0 && hinted) ? hint : grp.next_block;
+        found = grp.tree.FindRun(count, from);
+        if (found < 0 && from > grp.first_block)
+            found = grp.tree.FindRun(count, grp.first_block);
+        if (found < 0)
+            continue;
+        // 3. 一次性标记整段，组游标移到这一段之后
+        SetBitRange(found, count, true);
+        grp.tree.UpdateRange(found, count, true);
+        grp.free_blocks = grp.tree.FreeCount();
+        grp.next_block = (found + count < grp.end_block) ? found + count : grp.first_block;
+        if (lastBlockGroup.load(std::memory_order_relaxed) != g)
+            lastBlockGroup = g;
+    }
+    if (found < 0)
+    {
+        // 没有足够长的连续段，扣除的块数原样退回
+        if (reserved)
+            state.reserved += count;
+        else
+            availBlocks += count;
+        return -1;
+    }
+    MarkSuperBlockDirty();
+    // 4. 覆盖这一段的位图块同步一次
+    if (!SyncBitmapRange(found, count))
+    {
+        std::cerr << "错误：同步位图块到磁盘失败!" << std::endl;
+        return -1;
+    }
+    return found;
+}
+
+// 释放从 start 开始的 count 个连续物理块，跨越分配组边界时逐组处理
+bool DiskManager::FreeExtent(uint32_t start, uint32_t count)
 {
     // 1. 安全检查
-    if (block_id < sb.data_start || block_id >= sb.total_blocks)
+    if (count == 0)
+        return true;
+    if (start < sb.data_start || start + count > sb.total_blocks)
     {
-        std::cerr << "错误：不能释放保留区块! " << block_id << std::endl;
+        std::cerr << "错误：不能释放保留区块! " << start << std::endl;
         return false;
     }
-    // 2. 定位位图中的位置
-    uint32_t byte_idx = block_id / 8;
-    uint32_t bit_idx = block_id % 8;
-    // 3. 将位图对应位置改为 0
-    bitmap[byte_idx] &= ~(0x80 >> bit_idx);
-    // 4. 同步该位图块到磁盘
-    uint32_t bitmap_block_id = sb.bitmap_start + (byte_idx / BLOCK_SIZE);
-    uint32_t offset_in_bitmap = (byte_idx / BLOCK_SIZE) * BLOCK_SIZE;
-    char *block_ptr = reinterpret_cast<char *>(&bitmap[offset_in_bitmap]);
-    if (!WriteBlock(bitmap_block_id, block_ptr))
+    // 2. 事务中释放的块先登记再清除位：释放它的事务持久之前，重新分配到它的文件数据不能原地写入
+    if (InTransaction())
+    {
+        uint64_t seq = LocalState().seq;
+        std::lock_guard<std::mutex> guard(reuseMutex);
+        for (uint32_t b = start; b < start + count; ++b)
+        {
+            uint64_t &freedBy = freedBlocks[b];
+            freedBy = std::max(freedBy, seq);
+        }
+    }
+    // 3. 逐组清除并更新摘要树
+    for (uint32_t pos = start; pos < start + count;)
+    {
+        AllocGroup &grp = *groups[GroupOfBlock(pos)];
+        uint32_t len = std::min(start + count, grp.end_block) - pos;
+        std::lock_guard<std::mutex> guard(grp.blockMutex);
+        SetBitRange(pos, len, false);
+        grp.tree.UpdateRange(pos, len, false);
+        grp.free_blocks = grp.tree.FreeCount();
+        pos += len;
+    }
+    availBlocks += count;
+    MarkSuperBlockDirty();
+    // 4. 同步位图块
+    return SyncBitmapRange(start, count);
+}
+
+// Inode 位图从位图区第 sb.inode_bitmap_offset 字节开始，与块位图共用同一片内存；
+// 旧镜像中编号较大的 Inode 会与数据区的块位重叠，因此修改 Inode 位后要把对应块的状态同步到所在组的摘要树
+void DiskManager::SyncInodeBitToTree(uint32_t inode_id)
+{
+    uint64_t bit = (uint64_t)sb.inode_bitmap_offset * 8 + inode_id;
+    if (bit < sb.data_start || bit >= sb.total_blocks)
+        return;
+    AllocGroup &grp = *groups[GroupOfBlock(bit)];
+    std::lock_guard<std::mutex> guard(grp.blockMutex);
+    uint32_t before = grp.tree.FreeCount();
+    grp.tree.Update(bit, (bitmap[bit / 8] & (0x80 >> (bit % 8))) != 0);
+    grp.free_blocks = grp.tree.FreeCount();
+    availBlocks += (int64_t)grp.free_blocks - before;
+}
+
+// 获取空间使用情况：全部来自各组的摘要树，无需扫描位图
+SpaceInfo DiskManager::GetSpaceInfo()
+{
+    SpaceInfo info;
+    info.total_blocks = sb.total_blocks;
+    info.data_blocks = sb.total_blocks - sb.data_start;
+    info.groups = groups.size();
+    for (auto &grp : groups)
+    {
+        std::lock_guard<std::mutex> guard(grp->blockMutex);
+        info.free_blocks += grp->tree.FreeCount();
+        info.largest_free_run = std::max(info.largest_free_run, grp->tree.LargestRun());
+    }
+    return info;
+}
+
+// Inode 表的起始块号
+uint32_t DiskManager::GetInodeStart()
+{
+    return sb.inode_start;
+}
+
+// 读取 Inode：从 Inode 缓存中拷贝，未命中时才读取 Inode 块
+bool DiskManager::ReadInode(uint32_t inode_id, Inode &node)
+{
+    std::lock_guard<std::mutex> guard(inodeMutex);
+    InodeCacheEntry *entry = LoadInode(inode_id);
+    if (entry == nullptr)
         return false;
-    // 5. 更新超级块空闲统计
-    sb.free_blocks++;
-    // 6. 同步超级块
-    if (!WriteBlock(0, reinterpret_cast<char *>(&sb)))
+    memcpy(&node, &entry->node, sizeof(Inode));
+    return true;
+}
+
+// 写入 Inode：只修改内存中的 Inode 并标记为脏，写回推迟到 Sync
+bool DiskManager::WriteInode(uint32_t inode_id, const Inode &node)
+{
+    if (readOnly)
+    {
+        std::cerr << "错误：镜像以只读方式挂载，不能写入 Inode " << inode_id << "!" << std::endl;
         return false;
+    }
+    std::lock_guard<std::mutex> guard(inodeMutex);
+    // 整个 Inode 都会被覆盖，因此未命中时也无需先读出旧的 Inode 块
+    auto it = inodeCache.find(inode_id);
+    if (it == inodeCache.end())
+    {
+        ShrinkInodeCache();
+        it = inodeCache.emplace(inode_id, InodeCacheEntry()).first;
+    }
+    // 只改写变化了的字：其他线程可能正通过钉住的指针读取不变的字段（类型、权限、属主）
+    char *dst = reinterpret_cast<char *>(&it->second.node);
+    const char *src = reinterpret_cast<const char *>(&node);
+    for (size_t off = 0; off < sizeof(Inode); off += sizeof(uint32_t))
+        if (memcmp(dst + off, src + off, sizeof(uint32_t)) != 0)
+            memcpy(dst + off, src + off, sizeof(uint32_t));
+    it->second.dirty = true;
     return true;
 }
 
-// 读取 Inode
-bool DiskManager::ReadInode(uint32_t inode_id, Inode &node)
+// 钉住 Inode：返回缓存中 Inode 的指针，在 UnpinInode 之前不会被淘汰
+Inode *DiskManager::PinInode(uint32_t inode_id)
+{
+    std::lock_guard<std::mutex> guard(inodeMutex);
+    InodeCacheEntry *entry = LoadInode(inode_id);
+    if (entry == nullptr)
+        return nullptr;
+    entry->ref_count++;
+    return &entry->node;
+}
+
+// 解除钉住，dirty 为 true 表示调用者通过指针修改过该 Inode
+void DiskManager::UnpinInode(uint32_t inode_id, bool dirty)
+{
+    std::lock_guard<std::mutex> guard(inodeMutex);
+    auto it = inodeCache.find(inode_id);
+    if (it == inodeCache.end())
+        return;
+    if (it->second.ref_count > 0)
+        it->second.ref_count--;
+    if (dirty)
+        it->second.dirty = true;
+}
+
+// 标记钉住的 Inode 已通过指针修改，修改随当前事务一起提交
+void DiskManager::MarkInodeDirty(uint32_t inode_id)
+{
+    std::lock_guard<std::mutex> guard(inodeMutex);
+    auto it = inodeCache.find(inode_id);
+    if (it != inodeCache.end())
+        it->second.dirty = true;
+}
+
+// 在 Inode 缓存中查找，未命中时从 Inode 块加载（调用者持有 inodeMutex）
+InodeCacheEntry *DiskManager::LoadInode(uint32_t inode_id)
 {
+    auto it = inodeCache.find(inode_id);
+    if (it != inodeCache.end())
+    {
+        inodeStats.hits++;
+        return &it->second;
+    }
+    inodeStats.misses++;
+    if (inode_id >= sb.inode_count)
+        return nullptr;
     // 1. 计算物理位置
     uint32_t block_id = sb.inode_start + (inode_id / INODES_PER_BLOCK);
     uint32_t offset = (inode_id % INODES_PER_BLOCK) * sizeof(Inode);
-    // 2. 读取整个块
+    // 2. 读出所在块：Inode 块可能同时被其他线程的提交改写，因此在缓存锁内拷贝而不是 PeekBlock
+    ShrinkInodeCache();
     char buffer[BLOCK_SIZE];
     if (!ReadBlock(block_id, buffer))
-        return false;
-    // 3. 从块中拷贝出对应的 Inode 部分
-    memcpy(&node, buffer + offset, sizeof(Inode));
-    return true;
+        return nullptr;
+    // 3. 从块中拷贝出对应的 Inode 部分放入缓存
+    InodeCacheEntry &entry = inodeCache[inode_id];
+    memcpy(&entry.node, buffer + offset, sizeof(Inode));
+    return &entry;
 }
 
-// 写入 Inode
-bool DiskManager::WriteInode(uint32_t inode_id, const Inode &node)
+// 将所有脏 Inode 写回所在的 Inode 块，同一块内的多个 Inode 只写一次
+bool DiskManager::FlushInodes()
 {
-    // 1. 定位
-    uint32_t target_block = sb.inode_start + (inode_id / 4);
-    uint32_t offset_in_block = (inode_id % 4) * sizeof(Inode);
-    // 2. 读出原有的块数据 (读-改-写的第一步)
+    std::vector<uint32_t> dirtyIds;
+    for (auto &item : inodeCache)
+        if (item.second.dirty)
+            dirtyIds.push_back(item.first);
+    std::sort(dirtyIds.begin(), dirtyIds.end());
     char buffer[BLOCK_SIZE];
-    if (!ReadBlock(target_block, buffer))
-        return false;
-    // 3. 将新的 Inode 数据覆盖到缓冲区的正确位置 (修改)
-    memcpy(buffer + offset_in_block, &node, sizeof(Inode));
-    // 4. 写回整个块 (写)
-    if (!WriteBlock(target_block, buffer))
-        return false;
-    return true;
+    uint32_t currentBlock = 0xFFFFFFFF;
+    bool ok = true;
+    for (size_t i = 0; i < dirtyIds.size(); ++i)
+    {
+        uint32_t id = dirtyIds[i];
+        uint32_t block_id = sb.inode_start + (id / INODES_PER_BLOCK);
+        // 进入新的 Inode 块时才读一次
+        if (block_id != currentBlock)
+        {
+            if (!ReadBlock(block_id, buffer))
+            {
+                ok = false;
+                continue;
+            }
+            currentBlock = block_id;
+        }
+        memcpy(buffer + (id % INODES_PER_BLOCK) * sizeof(Inode), &inodeCache[id].node, sizeof(Inode));
+        inodeCache[id].dirty = false;
+        inodeStats.writebacks++;
+        // 该块的最后一个脏 Inode 处理完后写回整个块
+        bool lastInBlock = (i + 1 == dirtyIds.size()) ||
+                           (sb.inode_start + dirtyIds[i + 1] / INODES_PER_BLOCK != block_id);
+        if (lastInBlock && !WriteBlock(block_id, buffer))
+            ok = false;
+    }
+    return ok;
+}
+
+// Inode 缓存已满时淘汰未被钉住的 Inode，脏 Inode 先暂存进运行中的事务（调用者持有 inodeMutex）
+// 有句柄开启时，脏 Inode 可能正被句柄修改，不能拷贝，只淘汰干净的；没有句柄时和提交一样封闭事务，暂存期间不开启新句柄
+// 取不到事务锁或者提交者正在封闭事务时同样只淘汰干净的
+void DiskManager::ShrinkInodeCache()
+{
+    if (inodeCache.size() < INODE_CACHE_CAPACITY)
+        return;
+    if (txnMutex.try_lock())
+    {
+        bool stage = txnHandles == 0 && !txnSealing;
+        if (stage)
+            txnSealing = true;
+        txnMutex.unlock();
+        if (stage)
+        {
+            txnStager = std::this_thread::get_id();
+            FlushInodes();
+            txnStager = std::thread::id();
+            {
+                std::lock_guard<std::mutex> guard(txnMutex);
+                txnSealing = false;
+            }
+            txnCond.notify_all();
+        }
+    }
+    // 一次淘汰四分之一，避免每次插入都触发淘汰
+    size_t target = INODE_CACHE_CAPACITY * 3 / 4;
+    for (auto it = inodeCache.begin(); it != inodeCache.end() && inodeCache.size() > target;)
+    {
+        if (it->second.ref_count == 0 && !it->second.dirty)
+            it = inodeCache.erase(it);
+        else
+            ++it;
+    }
 }
 
 // 申请一个 Inode，返回 Inode 编号，失败返回 -1
-int DiskManager::AllocateInode()
-{
-    int foundId = -1;
-    // 1. 扫描查找
-    for (uint32_t i = 0; i < INODE_BITMAP_BYTES; ++i)
-    {
-        uint32_t currentByteIdx = INODE_BITMAP_START_BYTE + i;
-        if (bitmap[currentByteIdx] != 0xFF)
-            for (int bit = 0; bit < 8; ++bit)
-                if (!(bitmap[currentByteIdx] & (0x80 >> bit)))
-                {
-                    foundId = i * 8 + bit;
-                    break;
-                }
-        if (foundId != -1)
-            break;
+// 普通文件放在父目录所在的组，新目录分散到空闲较多的组；本组用完时依次尝试后面的组
+int DiskManager::AllocateInode(uint32_t parentInode, bool isDir)
+{
+    if (groups.empty())
+        return -1;
+    const uint32_t n = groups.size();
+    uint32_t home = isDir ? ChooseDirGroup() : std::min(GroupOfInode(parentInode), n - 1);
+    const uint8_t *inodeBits = bitmap + sb.inode_bitmap_offset;
+    int64_t found = -1;
+    uint32_t g = home;
+    for (uint32_t i = 0; i < n && found < 0; ++i)
+    {
+        g = (home + i) % n;
+        AllocGroup &grp = *groups[g];
+        if (grp.free_inodes == 0)
+            continue;
+        std::lock_guard<std::mutex> guard(grp.inodeMutex);
+        // 1. 从组游标开始按字扫描组内的 Inode 位图，扫到组末尾后回绕
+        found = FindBit(inodeBits, grp.next_inode, grp.end_inode, false);
+        if (found < 0)
+            found = FindBit(inodeBits, grp.first_inode, grp.next_inode, false);
+        if (found < 0)
+            continue;
+        // 2. 更新内存位图和组内计数
+        SetBitRange(sb.inode_bitmap_offset * 8 + found, 1, true);
+        SyncInodeBitToTree(found);
+        grp.free_inodes--;
+        grp.next_inode = (found + 1 < grp.end_inode) ? found + 1 : grp.first_inode;
+        if (lastInodeGroup.load(std::memory_order_relaxed) != g)
+            lastInodeGroup = g;
     }
-    if (foundId == -1)
+    if (found < 0)
         return -1;
-    // 2. 更新内存位图 (必须使用和查找时完全一样的偏移逻辑)
-    uint32_t targetByteIdx = INODE_BITMAP_START_BYTE + (foundId / 8);
-    bitmap[targetByteIdx] |= (0x80 >> (foundId % 8));
-    // 3. 计算磁盘同步位置
-    // byteOffset 是该字节在整个位图区（从 bitmap[0] 开始算）的偏移
-    uint32_t byteOffset = targetByteIdx;
-    uint32_t blockOffset = byteOffset / BLOCK_SIZE;
-    uint32_t targetPhysBlock = sb.bitmap_start + blockOffset;
-    // 4. 写回受影响的“对齐”块
-    // 必须从这个块的起始地址开始写，即 memStartIdx 必须是 BLOCK_SIZE 的倍数
-    uint32_t memStartIdx = blockOffset * BLOCK_SIZE;
-    if (!WriteBlock(targetPhysBlock, reinterpret_cast<char *>(&bitmap[memStartIdx])))
-    {
-        // 回滚
-        bitmap[targetByteIdx] &= ~(0x80 >> (foundId % 8));
+    // 游标随超级块一起持久化
+    MarkSuperBlockDirty();
+    // 3. 写回受影响的位图块，失败时回滚
+    uint32_t bit = sb.inode_bitmap_offset * 8 + found;
+    if (!SyncBitmapRange(bit, 1))
+    {
+        std::lock_guard<std::mutex> guard(groups[g]->inodeMutex);
+        SetBitRange(bit, 1, false);
+        SyncInodeBitToTree(found);
+        groups[g]->free_inodes++;
         return -1;
     }
-    return foundId;
+    return (int)found;
 }
 
 // 初始化 Inode
@@ -290,12 +1735,16 @@ bool DiskManager::InitInode(uint32_t inode_id, uint32_t mode, uint32_t block_id,
     newNode.inode_id = inode_id;
     newNode.mode = mode;
     newNode.size = 0;
-    newNode.block_count = 1; // 初始占用 1 个块
-    newNode.direct_ptr[0] = block_id;
+    // block_id 为 0 时不占用数据块，内容内联存放在 Inode 中
+    if (block_id != 0)
+    {
+        newNode.block_count = 1; // 初始占用 1 个块
+        newNode.direct_ptr[0] = block_id;
+    }
+    else
+        newNode.flags = INODE_INLINE;
     newNode.owner_id = uid;   // 记录该文件属于哪个用户
     newNode.group_id = gid;   // 记录该文件属于哪个组
-    newNode.reader_count = 0; // 初始没有读者
-    newNode.is_writing = 0;   // 初始没有写者
     // 3. 将 Inode 写入磁盘
     if (!WriteInode(inode_id, newNode))
         return false;
@@ -305,29 +1754,27 @@ bool DiskManager::InitInode(uint32_t inode_id, uint32_t mode, uint32_t block_id,
 // 释放 Inode
 bool DiskManager::FreeInode(uint32_t inodeId)
 {
-    // 1. 计算在内存 bitmap 向量中的位置
-    uint32_t byteOffset = INODE_BITMAP_START_BYTE + (inodeId / 8);
-    uint32_t bitOffset = inodeId % 8;
-    // 2. 修改内存位图 (清零)
-    // 检查是否已经是 0，防止重复释放导致 sb.free_inodes 计数错误
-    if (!(bitmap[byteOffset] & (0x80 >> bitOffset)))
+    if (inodeId >= sb.inode_count)
+        return false;
+    uint32_t bit = sb.inode_bitmap_offset * 8 + inodeId;
     {
-        std::cerr << "错误：Inode " << inodeId << " 已经是空闲状态！" << std::endl;
-        return true;
+        AllocGroup &grp = *groups[GroupOfInode(inodeId)];
+        std::lock_guard<std::mutex> guard(grp.inodeMutex);
+        // 1. 检查是否已经是 0，防止重复释放
+        if (!(bitmap[bit / 8] & (0x80 >> (bit % 8))))
+        {
+            std::cerr << "错误：Inode " << inodeId << " 已经是空闲状态！" << std::endl;
+            return true;
+        }
+        // 2. 修改内存位图 (清零)
+        SetBitRange(bit, 1, false);
+        SyncInodeBitToTree(inodeId);
+        grp.free_inodes++;
     }
-    bitmap[byteOffset] &= ~(0x80 >> bitOffset);
     // 3. 同步位图到磁盘 (只写回受影响的那个块)
-    // 确定该字节属于位图的第几个块
-    uint32_t blockOffset = byteOffset / BLOCK_SIZE;
-    uint32_t targetBlockId = sb.bitmap_start + blockOffset;
-    // 获取指向该块起始位置的指针
-    uint8_t *blockPtr = &bitmap[blockOffset * BLOCK_SIZE];
-    if (!WriteBlock(targetBlockId, reinterpret_cast<char *>(blockPtr)))
-        return false;
-    // 4. 更新内存中的超级块计数并写回磁盘
-    if (!WriteBlock(targetBlockId, reinterpret_cast<char *>(&bitmap[blockOffset * BLOCK_SIZE])))
-        return -1;
-    // 5. 清理磁盘上的 Inode 结构体区域 (防止残留数据)
+    if (!SyncBitmapRange(bit, 1))
+        return false;
+    // 4. 清理磁盘上的 Inode 结构体区域 (防止残留数据)
     Inode emptyInode;
     memset(&emptyInode, 0, sizeof(Inode));
     emptyInode.inode_id = inodeId; // 保持 ID 一致
@@ -338,19 +1785,21 @@ bool DiskManager::FreeInode(uint32_t inodeId)
 
 void DiskManager::DumpBitmapOccupiedPart()
 {
-    // 假设系统占用块是 1032 (8个位图块 + 1024个Inode块)
-    const uint32_t SYSTEM_BLOCKS = 1032;
-    // 对应的字节数 = 1032 / 8 = 129 字节
+    // 系统占用块是数据区之前的所有块（超级块、位图区、Inode 区和日志区）
+    const uint32_t SYSTEM_BLOCKS = sb.data_start;
+    // 每个字节记录 8 个块
     uint32_t bytes_to_read = (SYSTEM_BLOCKS + 7) / 8;
     std::vector<uint8_t> buffer(bytes_to_read);
-    // 从磁盘起始位置（Block 1）读取位图内容
+    // 直接读取镜像文件前，先把缓存中的脏块写回
+    Sync();
+    // 从位图区起始块读取位图内容
     std::ifstream ifs(this->path, std::ios::binary);
     if (!ifs)
     {
         std::cerr << "错误：无法打开磁盘文件进行调试！" << std::endl;
         return;
     }
-    ifs.seekg(512);
+    ifs.seekg((std::streamoff)sb.bitmap_start * BLOCK_SIZE);
     ifs.read(reinterpret_cast<char *>(buffer.data()), bytes_to_read);
     std::cout << "--- 位图占用区（系统块）状态 ---" << std::endl;
     std::cout << "每行显示 8 个字节 (代表 64 个块的状态)" << std::endl;
@@ -368,4 +1817,6 @@ void DiskManager::DumpBitmapOccupiedPart()
     }
     std::cout << "\n\n--- 输出结束 ---" << std::endl;
     ifs.close();
-}
\ No newline at end of file
+}
+
+} // namespace FS_NAMESPACE
@@ -2,36 +2,218 @@
 #define DISK_MANAGER_H
 
 #include "FileSystem.h"
+#include "BlockDevice.h"
+#include "FreeSpaceTree.h"
 
+namespace FS_NAMESPACE
+{
+
+// 磁盘管理器可以被多个线程同时调用：块缓存、Inode 缓存、各分配组和事务各有锁，
+// 加锁顺序为 提交 -> 事务句柄 -> 写回 -> 异步批次 -> Inode 缓存 -> 块缓存/暂存块 -> 日志刷新，分配组的锁内不做任何 I/O；
+// 线程在事务句柄内不能等待 LockManager 的访问权（提交要等所有句柄关闭），需要的访问权在开启事务之前取得；
+// 钉住的 Inode 和块的内容本身由 LockManager 的文件访问权保护
 class DiskManager
 {
 private:
-    std::fstream disk;
+    // 分配组：数据区按 GROUP_BLOCKS 划分，每组对应一个位图块、一棵摘要树和一段 Inode 编号，
+    // 不同组上的分配互不等待，也不等待事务（各线程的句柄并发分配）；块分配和 Inode 分配分别加锁，同时需要时先 Inode 后块；
+    // 分配只写本组的状态，全组共用的游标和超级块标记只在换组或第一次变脏时写一次
+    struct AllocGroup
+    {
+        uint32_t first_block = 0;             // 组内第一个数据块
+        uint32_t end_block = 0;               // 组内最后一个数据块之后的块号
+        uint32_t first_inode = 0;             // 组内第一个 Inode 编号
+        uint32_t end_inode = 0;               // 组内最后一个 Inode 编号之后
+        uint32_t next_block = 0;              // 组内块分配的 next-fit 游标
+        uint32_t next_inode = 0;              // 组内 Inode 分配的 next-fit 游标
+        FreeSpaceTree tree;                   // 组内块位图的摘要树
+        std::mutex blockMutex;                // 保护组内的块位、摘要树和块游标
+        std::mutex inodeMutex;                // 保护组内的 Inode 位和 Inode 游标
+        std::atomic<uint32_t> free_blocks{0}; // 空闲块数，选组时不加锁读取
+        std::atomic<uint32_t> free_inodes{0}; // 空闲 Inode 数
+    };
+
+    // 线程在这个磁盘管理器上的私有状态
+    struct ThreadState
+    {
+        uint32_t reserved = 0;    // 本线程预留、还没有用掉的块数
+        bool journalData = false; // 本线程的事务把文件数据也写进日志
+        int depth = 0;            // 本线程事务句柄的嵌套深度，大于 0 时写入的块暂存在运行中的事务里
+        uint32_t budget = 0;      // 本线程的句柄预计暂存的块数，计入运行中事务的估算
+        uint64_t seq = 0;         // 本线程的句柄所在事务的序号
+    };
+
+    BlockDevice *device;         // 块设备后端
     SuperBlock sb;               // 常驻内存的超级块
-    std::vector<uint8_t> bitmap; // 常驻内存的位图 (4096 字节)
+    std::vector<uint8_t> bitmapStore; // 位图的内存副本，映射模式下也不直接修改映射区
+    uint8_t *bitmap;                  // 常驻内存的位图区（块位图 + Inode 位图），指向 bitmapStore
+    bool mapped = false;              // 是否处于内存映射模式
+    std::vector<std::unique_ptr<AllocGroup>> groups; // 分配组，挂载时根据位图重建
+    uint32_t groupBase = 0;                          // 第一个分配组的组号（整组都是系统区的组不建）
+    uint32_t inodesPerGroup = 0;                     // 每组的 Inode 数（64 的倍数，不同组不共用位图字）
+    std::atomic<uint32_t> dirRotor{0};               // 新目录选组的轮转起点
+    uint32_t groupSeed = 0;                          // 各线程首选组的起点：上次卸载前最后分配块的组
+    std::atomic<uint32_t> lastBlockGroup{0};         // 最近一次块分配所在的组，它的游标随超级块持久化
+    std::atomic<uint32_t> lastInodeGroup{0};         // 最近一次 Inode 分配所在的组，它的游标随超级块持久化
+    std::atomic<int64_t> availBlocks{0};             // 可以分配的块数：空闲块减去各线程预留的块
     std::string path;            // 虚拟磁盘的路径
+    bool readOnly = false;       // 镜像正由其他进程修改，本进程只读不写（挂载前设置）
+
+    std::list<CacheBlock> cache;                                              // 块缓存 (LRU 链表，表头为最近使用)
+    std::unordered_map<uint32_t, std::list<CacheBlock>::iterator> cacheIndex; // 块号 -> 缓存槽位
+    CacheStats cacheStats;                                                    // 缓存命中统计
+    std::unordered_map<uint32_t, InodeCacheEntry> inodeCache;                 // Inode 编号 -> 内存 Inode
+    CacheStats inodeStats;                                                    // Inode 缓存命中统计
+    std::vector<PendingRead> pendingReads;                                    // 等待 Wait 完成后放入缓存的读请求（属于持有批次的线程）
+    std::mutex cacheMutex;                                                    // 保护块缓存和缓存统计，磁盘读写不在锁内进行
+    std::condition_variable cacheCond;                                        // 等待其他线程装入的块
+    uint64_t cacheGeneration = 0;                                             // 每写回一次加一，用来判断异步读到的内容是否可能过期
+    std::mutex inodeMutex;                                                    // 保护 Inode 缓存和统计
+    std::atomic<bool> sbDirty{false};                                         // 空闲计数有变化，事务提交或 Sync 时统一写一次超级块
+
+    std::mutex batchMutex;                       // 异步批次：从线程第一次提交到 Wait 之间持有，后端的提交队列一次只属于一个线程
+    std::atomic<std::thread::id> batchOwner{};   // 持有批次的线程
+    uint64_t batchGeneration = 0;                // 批次开始时的 cacheGeneration
+
+    // 复合事务：各线程的事务句柄并入同一个运行中的事务，由最后提交的线程整体写成一条日志记录（组提交）
+    std::mutex txnMutex;                                       // 保护句柄计数和事务序号，持有期间不做任何 I/O
+    std::condition_variable txnCond;                           // 等待句柄全部关闭，或等待运行中的事务换新
+    uint32_t txnHandles = 0;                                   // 运行中事务里还没关闭的最外层句柄数
+    uint32_t txnBudget = 0;                                    // 这些句柄预计暂存的块数之和
+    bool txnSealing = false;                                   // 提交者正在封闭运行中的事务，新句柄等它换上下一个事务
+    uint64_t txnSeq = 1;                                       // 运行中事务的序号
+    std::atomic<std::thread::id> txnStager{};                  // 正在把超级块和脏 Inode 暂存进运行中事务的线程
+    std::mutex commitMutex;                                    // 提交和检查点一次只由一个线程做，日志记录按事务序号依次写入
+    uint64_t committedSeq = 0;                                 // 已经提交的最大事务序号（commitMutex 保护）
+    uint64_t failedSeq = 0;                                    // 最近一个提交失败的事务序号（commitMutex 保护）
+    std::mutex stageMutex;                                     // 保护 txnBlocks 和 commitBlocks 的表结构
+    std::map<uint32_t, std::shared_ptr<char[]>> txnBlocks;     // 运行中事务写入的块，所有线程都以这里的内容为准
+    std::map<uint32_t, std::shared_ptr<char[]>> commitBlocks;  // 正在提交、还没进入缓存的块，内容不再修改
+    std::atomic<size_t> stagedCount{0};                        // 以上两者的块数之和，为 0 时读块不必查暂存
+    std::atomic<bool> txnOrdered{false};                       // 运行中事务是否有直接写到原位置的文件数据
+    std::mutex reuseMutex;                                     // 保护 journaledBlocks、freedBlocks 和 journaledSeq
+    std::set<uint32_t> journaledBlocks;                        // 上次检查点之后写进日志的块，重放时会被改写
+    std::map<uint32_t, uint64_t> freedBlocks;                  // 释放后还没有持久的块 -> 释放它的事务序号
+    uint64_t journaledSeq = 0;                                 // 已经写进日志的最大事务序号
+    uint32_t journalHead = 1;                                  // 下一条日志记录在日志区内的块偏移
+    uint32_t journalSeq = 1;                                   // 下一条日志记录的序号
+    std::shared_mutex mapLock;                                 // 映射模式下保护映射区：写入独占，读取和拷贝共享
+
+    DurabilityPolicy durability = DURABILITY_ALWAYS;  // 持久化策略
+    uint32_t flushIntervalMs = FLUSH_INTERVAL_MS;     // 定期写回的间隔（毫秒）
+    std::atomic<bool> journalUnflushed{false};        // 日志中有已写入但尚未刷新的记录，原位置写回前必须先刷新
+    std::mutex journalFlushMutex;                     // 保证看到日志已刷新的线程，刷新确实已经完成
+    std::mutex writebackMutex;                        // 同一时间只有一轮脏块写回，避免旧副本盖掉新副本
+    std::thread flusher;                              // 后台写回线程（定期写回策略）
+    std::mutex flusherMutex;                          // 保护 flusherStop
+    std::condition_variable flusherCond;              // 唤醒后台写回线程
+    bool flusherStop = false;                         // 通知后台写回线程退出
+
+    CacheBlock *LookupCache(uint32_t block_id);
+    CacheBlock *InsertCache(uint32_t block_id);
+    CacheBlock *AcquireBlock(uint32_t block_id, std::unique_lock<std::mutex> &lock);
+    void DropCache(uint32_t block_id);
+    bool WriteBack(CacheBlock &cb);
+    bool WriteBackDirty();
+    void FlusherLoop();
+    void StopFlusher();
+    void ClearCache();
+    bool InTransaction();
+    bool ReadStaged(uint32_t block_id, char *buffer);
+    void StageBlock(uint32_t block_id, const char *buffer);
+    bool StoreBlock(uint32_t block_id, const char *buffer);
+    uint32_t TxnCapacity() const;
+    bool CommitThrough(uint64_t seq);
+    bool CommitRunning();
+    bool Checkpoint(uint64_t durableSeq);
+    void BeginBatch();
+    bool LoadSuperBlock();
+    void MarkSuperBlockDirty();
+    bool FlushSuperBlock();
+    static int64_t FindBit(const uint8_t *bits, uint32_t start, uint32_t end, bool set);
+    void SetBitRange(uint32_t start, uint32_t count, bool value);
+    bool SyncBitmapRange(uint32_t start, uint32_t count);
+    void SyncInodeBitToTree(uint32_t inode_id);
+    void BuildGroups();
+    uint32_t GroupOfBlock(uint32_t block_id) const;
+    uint32_t GroupOfInode(uint32_t inode_id) const;
+    uint32_t ThreadGroup() const;
+    uint32_t ChooseDirGroup();
+    ThreadState &LocalState();
+    bool TakeAvailable(uint32_t count);
+    InodeCacheEntry *LoadInode(uint32_t inode_id);
+    bool FlushInodes();
+    void ShrinkInodeCache();
+    bool JournalEnabled() const;
+    bool NeedsJournal(uint32_t block_id);
+    bool WriteJournal(uint64_t seq);
+    bool ReplayJournal();
+    bool ResetJournal();
+    static uint32_t JournalChecksum(const JournalDescriptor &desc, const std::vector<const char *> &blocks);
 
 public:
-    DiskManager(const std::string &vdisk_path);
+    DiskManager(const std::string &vdisk_path, DiskBackend backend = DEFAULT_BACKEND);
     ~DiskManager();
 
     bool FileExists(const std::string &path);
-    bool InitializeDisk(const std::string &path);
+    bool InitializeDisk(const std::string &path, const Geometry &geo = Geometry());
 
     bool Mount();
     void UnMount();
+    void SetReadOnly(bool value);
+    bool IsReadOnly() const;
+    bool Refresh();
     bool ReadBlock(uint32_t block_id, char *buffer);
     bool WriteBlock(uint32_t block_id, char *buffer);
+    const char *PeekBlock(uint32_t block_id);
+    bool SubmitRead(uint32_t block_id, char *buffer);
+    bool SubmitWrite(uint32_t block_id, char *buffer);
+    bool Wait();
+    bool Sync();
+    bool FlushJournal();
+    void SetDurability(DurabilityPolicy policy, uint32_t intervalMs = FLUSH_INTERVAL_MS);
+    DurabilityPolicy GetDurability() const;
+    CacheStats GetCacheStats();
+    CacheStats GetInodeCacheStats();
+
+    void BeginTransaction(uint32_t journalBlocks = 0);
+    bool CommitTransaction();
 
     int AllocateBlock();
     bool FreeBlock(uint32_t block_id);
+    int AllocateExtent(uint32_t count, uint32_t hint = 0);
+    bool FreeExtent(uint32_t start, uint32_t count);
+    bool ReserveBlocks(uint32_t count);
+    void ReleaseReservation();
 
     bool ReadInode(uint32_t inode_id, Inode &node);
     bool WriteInode(uint32_t inode_id, const Inode &node);
-    int AllocateInode();
+    Inode *PinInode(uint32_t inode_id);
+    void UnpinInode(uint32_t inode_id, bool dirty = false);
+    void MarkInodeDirty(uint32_t inode_id);
+    int AllocateInode(uint32_t parentInode = 0, bool isDir = false);
+    uint32_t GroupGoal(uint32_t inode_id);
     bool InitInode(uint32_t inode_id, uint32_t mode, uint32_t block_id, uint32_t uid, uint32_t gid);
     bool FreeInode(uint32_t inode_id);
 
+    SpaceInfo GetSpaceInfo();
+    uint32_t GetInodeStart();
     void DumpBitmapOccupiedPart();
 };
-#endif
\ No newline at end of file
+
+// 事务守卫：构造时开启事务句柄，离开作用域时提交，可以嵌套；journalBlocks 大于 0 时文件数据也写进日志，取值为要写的数据块数
+class Transaction
+{
+private:
+    DiskManager *disk;
+
+public:
+    explicit Transaction(DiskManager *dm, uint32_t journalBlocks = 0) : disk(dm) { disk->BeginTransaction(journalBlocks); }
+    ~Transaction() { disk->CommitTransaction(); }
+    Transaction(const Transaction &) = delete;
+    Transaction &operator=(const Transaction &) = delete;
+};
+
+} // namespace FS_NAMESPACE
+
+#endif
@@ -1,108 +1,76 @@
 #include "FileManager.h"
 
-FileManager::FileManager(DiskManager *dm, DirectoryManager *dirm, SystemContext *ctx) : currentInodeId(0)
+namespace FS_NAMESPACE
+{
+
+FileManager::FileManager(DiskManager *dm, DirectoryManager *dirm, SystemContext *ctx, LockManager *lm) : currentInodeId(0), cwdPath("/")
 {
     this->disk = dm;
     this->dir = dirm;
     this->ctx = ctx;
+    this->locks = lm;
 }
 
-// 创建文件
+FileManager::~FileManager()
+{
+    CloseAll();
+}
+
+// 创建文件（调用者持有当前目录的写访问权）
 bool FileManager::CreateFile(const std::string &name, uint32_t customPerm)
 {
-    // 1. 分配空闲的 inode
-    uint32_t inodeNum = disk->AllocateInode();
+    // 整个操作作为一个事务提交，崩溃后要么全部生效要么全部不生效
+    Transaction txn(disk);
+    // 1. 在当前目录所在的分配组中分配空闲的 inode
+    uint32_t inodeNum = disk->AllocateInode(currentInodeId);
     if (inodeNum == -1)
         return false;
-    // 2. 分配空闲的 block
-    uint32_t blockNum = disk->AllocateBlock();
-    if (blockNum == -1)
-        return false;
-    // 3. 初始化 inode
+    // 2. 初始化 inode：新文件不分配数据块，内容先内联存放在 Inode 中，写大了再迁移到数据块
     // 如果用户没传权限，设置文件默认权限
     uint32_t perm = (customPerm == 0) ? ROOT_FILE_MODE : (customPerm & PERM_MASK);
     uint32_t mode = (TYPE_FILE << 9) | perm;
-    if (!disk->InitInode(inodeNum, mode, blockNum, (uint32_t)ctx->currentUser.userId, (uint32_t)ctx->currentUser.groupId))
+    if (!disk->InitInode(inodeNum, mode, 0, (uint32_t)ctx->currentUser.userId, (uint32_t)ctx->currentUser.groupId))
         return false;
-    // 4. 写入文件名
+    // 3. 写入文件名
     if (!dir->AddDirEntry(currentInodeId, name, inodeNum))
         return false;
     return true;
 }
 
+// 删除文件：查找和移除目录项期间持有当前目录的写访问权，文件本身需要能立即取得写访问权（没有人打开它）
 bool FileManager::DeleteFile(const std::string &name)
 {
+    AccessGuard dirGuard(locks, currentInodeId, true);
     // 1. 在当前目录查找文件
-    Inode parentNode;
-    if (!disk->ReadInode(currentInodeId, parentNode))
-        return false;
-    uint32_t entryCount = parentNode.size / DIR_ENTRY_SIZE;        // 目录项数量
-    int targetEntryIdx = -1;                                       // 目标目录项的索引
     uint32_t fileInodeId = dir->FindInodeId(name, currentInodeId); // 文件对应的 inode 编号
     if (fileInodeId == (uint32_t)-1)
     {
-        std::cerr << "错误：文件 " << name << " 不存在！" << std::endl;
+        SessionErr() << "错误：文件 " << name << " 不存在！" << std::endl;
         return false;
     }
-    for (uint32_t i = 0; i < entryCount; ++i)
+    if (!locks->RequestAccess(fileInodeId, true))
     {
-        uint32_t ptrIdx = (i * DIR_ENTRY_SIZE) / BLOCK_SIZE;
-        uint32_t offset = (i * DIR_ENTRY_SIZE) % BLOCK_SIZE;
-        char buffer[BLOCK_SIZE];
-        disk->ReadBlock(parentNode.direct_ptr[ptrIdx], buffer);
-        DirEntry *de = reinterpret_cast<DirEntry *>(buffer + offset);
-        if (name == de->name)
-        {
-            targetEntryIdx = i;
-            break;
-        }
+        SessionErr() << "文件保护：无法删除 '" << name << "'正在被其他用户访问，请稍后再试!" << std::endl;
+        return false;
     }
-    // 2. 释放文件占用的磁盘资源
-    Inode fileNode;
-    if (disk->ReadInode(fileInodeId, fileNode))
+    bool ok;
     {
-        // 释放该文件占用的所有物理块 (直接索引部分)
-        for (int i = 0; i < (int)fileNode.block_count; ++i)
+        // 访问权在事务之前取得；整个操作作为一个事务提交，崩溃后要么全部生效要么全部不生效
+        Transaction txn(disk);
+        // 2. 释放文件占用的磁盘资源
+        Inode fileNode;
+        if (disk->ReadInode(fileInodeId, fileNode))
         {
-            if (fileNode.direct_ptr[i] != 0)
-                disk->FreeBlock(fileNode.direct_ptr[i]);
+            // 释放该文件占用的所有物理块
+            FreeDataBlocks(fileNode);
+            // 释放 Inode 编号
+            disk->FreeInode(fileInodeId);
         }
-        // 释放 Inode 编号
-        disk->FreeInode(fileInodeId);
-    }
-    // 3. 清理目录项（覆盖法维持目录紧凑）
-    uint32_t lastIdx = entryCount - 1; // 最后一个目录项的索引
-    // 如果删除的不是最后一个，需要用最后一个来填补坑位
-    if (targetEntryIdx != (int)lastIdx)
-    {
-        // 读取最后一个目录项
-        char lastBlockBuf[BLOCK_SIZE];
-        uint32_t lastPtrIdx = (lastIdx * DIR_ENTRY_SIZE) / BLOCK_SIZE;
-        uint32_t lastOffset = (lastIdx * DIR_ENTRY_SIZE) % BLOCK_SIZE;
-        disk->ReadBlock(parentNode.direct_ptr[lastPtrIdx], lastBlockBuf);
-        DirEntry *lastEntry = reinterpret_cast<DirEntry *>(lastBlockBuf + lastOffset);
-        // 复制最后一个条目到目标位置（被删条目位置）
-        char targetBlockBuf[BLOCK_SIZE];
-        uint32_t targetPtrIdx = (targetEntryIdx * DIR_ENTRY_SIZE) / BLOCK_SIZE;
-        uint32_t targetOffset = (targetEntryIdx * DIR_ENTRY_SIZE) % BLOCK_SIZE;
-        disk->ReadBlock(parentNode.direct_ptr[targetPtrIdx], targetBlockBuf);
-        DirEntry *targetEntry = reinterpret_cast<DirEntry *>(targetBlockBuf + targetOffset);
-        memcpy(targetEntry, lastEntry, sizeof(DirEntry));
-        // 写回目标块
-        disk->WriteBlock(parentNode.direct_ptr[targetPtrIdx], targetBlockBuf);
-    }
-    // 4. 更新父目录元数据
-    parentNode.size -= DIR_ENTRY_SIZE;
-    // 如果 size 刚好退回到块边界，可以考虑减少 block_count
-    if (parentNode.size > 0 && parentNode.size % BLOCK_SIZE == 0 && parentNode.block_count > 1)
-    {
-        uint32_t emptyBlock = parentNode.direct_ptr[parentNode.block_count - 1];
-        disk->FreeBlock(emptyBlock);
-        parentNode.block_count--;
-    }
-    // 写回父目录元数据
-    disk->WriteInode(currentInodeId, parentNode);
-    return true;
+        // 3. 从当前目录中移除目录项（覆盖法维持目录紧凑，同时更新目录索引）
+        ok = dir->RemoveDirEntry(currentInodeId, name);
+    }
+    locks->ReleaseAccess(fileInodeId, true);
+    return ok;
 }
 
 // 获取当前所在目录的 Inode 编号
@@ -118,21 +86,24 @@ bool FileManager::MakeDirectory(const std::string &name, uint32_t customPerm)
     // 硬拦截访客:如果当前组是 GID_GUEST，直接拒绝
     if (ctx->currentUser.groupId == GID_GUEST)
     {
-        std::cout << "权限拒绝：访客组用户禁止创建目录!" << std::endl;
+        SessionOut() << "权限拒绝：访客组用户禁止创建目录!" << std::endl;
         return false;
     }
     // 目录权限校验:在父目录创建子目录，需要对父目录有写权限(W=2)
     if (!HasPermission(currentInodeId, PERM_W, ctx->currentUser))
     {
-        std::cout << "权限拒绝：你没有在当前目录下创建条目的权限!" << std::endl;
+        SessionOut() << "权限拒绝：你没有在当前目录下创建条目的权限!" << std::endl;
         return false;
     }
-    // 2. 分配 Inode
-    uint32_t newDirInodeId = disk->AllocateInode();
+    // 持有当前目录的写访问权后开启事务，整个操作作为一个事务提交，崩溃后要么全部生效要么全部不生效
+    AccessGuard dirGuard(locks, currentInodeId, true);
+    Transaction txn(disk);
+    // 2. 分配 Inode：新目录分散到空闲较多的分配组
+    uint32_t newDirInodeId = disk->AllocateInode(currentInodeId, true);
     if (newDirInodeId == (uint32_t)-1)
         return false;
-    // 3. 分配第一个数据块
-    uint32_t newDirBlockId = disk->AllocateBlock();
+    // 3. 在新目录的 Inode 所在组中分配第一个数据块
+    uint32_t newDirBlockId = disk->AllocateExtent(1, disk->GroupGoal(newDirInodeId));
     if (newDirBlockId == (uint32_t)-1)
         return false;
     // 4. 初始化 Inode
@@ -157,76 +128,106 @@ bool FileManager::MakeDirectory(const std::string &name, uint32_t customPerm)
     return dir->AddDirEntry(currentInodeId, name, newDirInodeId);
 }
 
+// 解析路径：支持以 / 开头的绝对路径和相对路径，可以包含多级目录以及 . 和 ..
+// 每经过一级目录都要求对该目录有执行权限；components 不为空时返回目标的规范化路径各级名字
+bool FileManager::ResolvePath(const std::string &path, uint32_t &inodeId, std::vector<std::string> *components)
+{
+    // 1. 确定起点：绝对路径从根目录开始，相对路径从当前目录开始
+    bool absolute = !path.empty() && path[0] == '/';
+    uint32_t current = absolute ? 0 : currentInodeId;
+    std::vector<std::string> names;
+    if (!absolute)
+        names = cwdComponents;
+    // 2. 逐级解析
+    std::stringstream ss(path);
+    std::string name;
+    while (std::getline(ss, name, '/'))
+    {
+        if (name.empty() || name == ".")
+            continue;
+        // 在目录中查找之前，它必须是目录且有执行权限
+        const Inode *node = disk->PinInode(current);
+        if (node == nullptr)
+            return false;
+        bool isDir = (node->mode >> 9) == TYPE_DIR;
+        disk->UnpinInode(current);
+        if (!isDir)
+        {
+            SessionErr() << "错误：路径 '" << path << "' 中的 '" << (names.empty() ? "/" : names.back()) << "' 不是一个目录！" << std::endl;
+            return false;
+        }
+        if (!HasPermission(current, PERM_X, ctx->currentUser))
+        {
+            SessionErr() << "错误：权限不足，无法访问 '" << (names.empty() ? "/" : names.back()) << "'!" << std::endl;
+            return false;
+        }
+        // 根目录的 .. 仍是根目录
+        if (name == ".." && current == 0)
+            continue;
+        uint32_t next;
+        {
+            // 查找期间持有目录的读访问权，不会看到其他会话修改到一半的目录
+            AccessGuard dirGuard(locks, current, false);
+            next = dir->FindInodeId(name, current);
+        }
+        if (next == (uint32_t)-1)
+        {
+            SessionErr() << "错误：路径 '" << path << "' 不存在！" << std::endl;
+            return false;
+        }
+        if (name == "..")
+        {
+            if (!names.empty())
+                names.pop_back();
+        }
+        else
+            names.push_back(name);
+        current = next;
+    }
+    inodeId = current;
+    if (components != nullptr)
+        components->swap(names);
+    return true;
+}
+
 // 切换当前工作目录
 bool FileManager::ChangeDirectory(const std::string &path)
 {
-    // 1. 在当前目录下查找目标路径对应的 Inode ID
-    uint32_t targetInodeId = dir->FindInodeId(path, currentInodeId);
-    if (targetInodeId == (uint32_t)-1)
-    {
-        std::cerr << "错误：路径 '" << path << "' 不存在！" << std::endl;
+    // 1. 解析目标路径对应的 Inode ID（沿途的目录都要有执行权限）
+    uint32_t targetInodeId;
+    std::vector<std::string> components;
+    if (!ResolvePath(path, targetInodeId, &components))
         return false;
-    }
     // 2. 获取该 Inode 的元数据，校验是否为目录
     Inode targetNode;
     if (!disk->ReadInode(targetInodeId, targetNode))
         return false;
-    // fileType 为 2 代表目录，1 代表普通文件
-    uint32_t fileType = targetNode.mode >> 9;
-    // 提取权限位:使用掩码
-    uint32_t filePerm = targetNode.mode & PERM_MASK;
-    if (fileType != 2)
+    if ((targetNode.mode >> 9) != TYPE_DIR)
     {
-        std::cerr << "错误：'" << path << "' 不是一个目录！" << std::endl;
+        SessionErr() << "错误：'" << path << "' 不是一个目录！" << std::endl;
         return false;
     }
     // 需要校验进入目录的权限
     if (!HasPermission(targetInodeId, PERM_X, ctx->currentUser))
     {
-        std::cerr << "错误：权限不足，无法进入目录 '" << path << "'!" << std::endl;
+        SessionErr() << "错误：权限不足，无法进入目录 '" << path << "'!" << std::endl;
         return false;
     }
-    // 3. 更新当前路径指针
+    // 3. 更新当前目录，并由规范化后的各级名字直接拼出路径缓存
     currentInodeId = targetInodeId;
+    cwdComponents.swap(components);
+    cwdPath.clear();
+    for (const std::string &component : cwdComponents)
+        cwdPath += "/" + component;
+    if (cwdPath.empty())
+        cwdPath = "/";
     return true;
 }
 
-// 获取当前工作目录的绝对路径字符串
+// 获取当前工作目录的绝对路径字符串：直接返回 cd 时维护的缓存，提示符渲染不需要任何磁盘读
 std::string FileManager::GetAbsolutePath()
 {
-    // 如果已经在根目录，直接返回 "/"
-    if (currentInodeId == 0)
-        return "/";
-    std::vector<std::string> pathComponents;
-    uint32_t tempInodeId = currentInodeId;
-    // 向上追溯直到根目录 (Inode 0)
-    while (tempInodeId != 0)
-    {
-        // 1. 获取当前目录的父目录 ID (通过读取当前目录下的 ".." 条目)
-        uint32_t parentInodeId = dir->FindInodeId("..", tempInodeId);
-        if (parentInodeId == (uint32_t)-1)
-            break;
-        // 2. 在父目录中查找 tempInodeId 对应的名字
-        // 我们需要遍历父目录的所有目录项
-        std::vector<DirEntry> parentEntries = dir->ListDirectory(parentInodeId);
-        bool found = false;
-        for (const auto &entry : parentEntries)
-            if (entry.inode_id == tempInodeId)
-            {
-                pathComponents.push_back(entry.name);
-                found = true;
-                break;
-            }
-        if (!found)
-            break;
-        // 3. 移动到父目录，继续向上找
-        tempInodeId = parentInodeId;
-    }
-    // 4. 将路径组件反向拼接
-    std::string fullPath = "";
-    for (int i = pathComponents.size() - 1; i >= 0; --i)
-        fullPath += "/" + pathComponents[i];
-    return fullPath;
+    return cwdPath;
 }
 
 // 创建文件
@@ -236,16 +237,17 @@ bool FileManager::TouchFile(const std::string &name, uint32_t customPerm)
     // 访客拦截
     if (ctx->currentUser.groupId == GID_GUEST)
     {
-        std::cout << "权限拒绝：访客账户无法执行 touch 操作!" << std::endl;
+        SessionOut() << "权限拒绝：访客账户无法执行 touch 操作!" << std::endl;
         return false;
     }
     // 检查对当前目录的写权限
     if (!HasPermission(currentInodeId, PERM_W, ctx->currentUser))
     {
-        std::cout << "权限拒绝：您没有当前目录的写权限!" << std::endl;
+        SessionOut() << "权限拒绝：您没有当前目录的写权限!" << std::endl;
         return false;
     }
-    // 2. 在当前目录下查找该文件是否已存在
+    // 2. 在当前目录下查找该文件是否已存在：查找和创建期间持有当前目录的写访问权，同名文件只会创建一次
+    AccessGuard dirGuard(locks, currentInodeId, true);
     uint32_t existingInodeId = dir->FindInodeId(name, currentInodeId);
     if (existingInodeId != (uint32_t)-1)
         return false; 
@@ -253,89 +255,621 @@ bool FileManager::TouchFile(const std::string &name, uint32_t customPerm)
         return CreateFile(name, customPerm); // 3. 如果文件不存在：直接创建新文件
 }
 
-// 向文件内写入内容
-bool FileManager::WriteFile(const std::string &name, const std::string &content)
+// 打开文件：解析路径、校验类型和权限并申请访问权，成功后返回文件描述符，失败返回 -1
+// 打开期间 Inode 保持钉住，块映射和访问权一直保留到 Close，之后的读写不再查找目录或重新加锁
+int FileManager::Open(const std::string &path, int flags)
 {
-    // 1. 查找文件 Inode
-    uint32_t inodeId = dir->FindInodeId(name, currentInodeId);
-    if (inodeId == (uint32_t)-1)
+    bool writable = (flags & OPEN_WRITE) != 0;
+    // 1. 解析路径并确认是普通文件
+    uint32_t inodeId;
+    if (!ResolvePath(path, inodeId))
+        return -1;
+    Inode *node = disk->PinInode(inodeId);
+    if (node == nullptr)
+        return -1;
+    bool isFile = (node->mode >> 9) == TYPE_FILE;
+    disk->UnpinInode(inodeId);
+    if (!isFile)
     {
-        std::cerr << "错误：文件不存在！" << std::endl;
-        return false;
+        SessionOut() << "错误: " << path << ":是一个目录！" << std::endl;
+        return -1;
     }
-    Inode node;
-    disk->ReadInode(inodeId, node);
-    if (node.mode != 1)
-    { // 确认是文件而非目录
-        std::cerr << "错误：不能向目录写入内容！" << std::endl;
+    // 2. 权限校验：读需要 PERM_R，写需要 PERM_W
+    if (!HasPermission(inodeId, writable ? PERM_W : PERM_R, ctx->currentUser))
+    {
+        SessionOut() << "权限拒绝：您没有当前文件的" << (writable ? "写" : "读") << "权限！" << std::endl;
+        return -1;
+    }
+    // 3. 取得最小的空闲描述符
+    int fd = 0;
+    while (fd < (int)openFiles.size() && openFiles[fd] != nullptr)
+        ++fd;
+    if (fd >= (int)MAX_OPEN_FILES)
+    {
+        SessionErr() << "错误：打开的文件过多！" << std::endl;
+        return -1;
+    }
+    // 4. 申请访问权，整个打开期间持有
+    if (!locks->RequestAccess(inodeId, writable))
+    {
+        SessionOut() << "文件保护：文件 '" << path << "' 正在被其他用户访问，请稍后再试!" << std::endl;
+        return -1;
+    }
+    // 5. 钉住 Inode 并建立块映射
+    // 检查类型到取得访问权之间，文件可能被其他会话删除或替换，拿到访问权后重新解析并确认仍是同一个普通文件
+    uint32_t checkId;
+    node = nullptr;
+    if (ResolvePath(path, checkId) && checkId == inodeId)
+        node = disk->PinInode(inodeId);
+    if (node == nullptr || (node->mode >> 9) != TYPE_FILE)
+    {
+        if (node != nullptr)
+            disk->UnpinInode(inodeId);
+        locks->ReleaseAccess(inodeId, writable);
+        SessionErr() << "错误：文件 '" << path << "' 在打开过程中被删除或替换！" << std::endl;
+        return -1;
+    }
+    std::unique_ptr<OpenFile> file(new OpenFile());
+    file->inode_id = inodeId;
+    file->node = node;
+    file->mapper.reset(new BlockMapper(disk, *file->node));
+    file->flags = flags;
+    file->offset = 0;
+    if (writable && (flags & OPEN_TRUNC) != 0)
+        TruncateRange(inodeId, *file->node, *file->mapper, 0);
+    if (fd == (int)openFiles.size())
+        openFiles.emplace_back();
+    openFiles[fd] = std::move(file);
+    return fd;
+}
+
+// 关闭文件描述符：写回块映射、解除钉住并释放访问权
+bool FileManager::Close(int fd)
+{
+    OpenFile *file = GetOpenFile(fd);
+    if (file == nullptr)
+        return false;
+    file->mapper.reset();
+    disk->UnpinInode(file->inode_id);
+    locks->ReleaseAccess(file->inode_id, (file->flags & OPEN_WRITE) != 0);
+    openFiles[fd].reset();
+    return true;
+}
+
+// 让文件已完成的写入持久：数据已经写到原位置，元数据已经作为事务提交到日志，刷新一次设备两者都持久，不必等原位置写回
+bool FileManager::Fsync(int fd)
+{
+    if (GetOpenFile(fd) == nullptr)
         return false;
+    if (!disk->FlushJournal())
+    {
+        SessionErr() << "错误：刷新文件描述符 " << fd << " 的写入失败！" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 关闭全部打开的文件
+void FileManager::CloseAll()
+{
+    for (size_t fd = 0; fd < openFiles.size(); ++fd)
+        if (openFiles[fd] != nullptr)
+            Close((int)fd);
+    openFiles.clear();
+}
+
+// 从当前位置读取最多 len 字节，位置随之后移；返回读取的字节数，失败返回 -1
+int64_t FileManager::Read(int fd, char *buf, uint32_t len)
+{
+    OpenFile *file = GetOpenFile(fd);
+    if (file == nullptr)
+        return -1;
+    int64_t n = ReadRange(*file->node, *file->mapper, file->offset, len, buf);
+    if (n > 0)
+        file->offset += n;
+    return n;
+}
+
+// 在当前位置写入 len 字节（追加模式下总是写到末尾），位置随之后移；返回写入的字节数，失败返回 -1
+int64_t FileManager::Write(int fd, const char *data, uint32_t len)
+{
+    OpenFile *file = GetOpenFile(fd);
+    if (file == nullptr)
+        return -1;
+    if ((file->flags & OPEN_WRITE) == 0)
+    {
+        SessionErr() << "错误：文件描述符 " << fd << " 不是以写方式打开的！" << std::endl;
+        return -1;
+    }
+    if ((file->flags & OPEN_APPEND) != 0)
+        file->offset = file->node->size;
+    int64_t n = WriteRange(file->inode_id, *file->node, *file->mapper, file->offset, data, len);
+    if (n > 0)
+        file->offset += n;
+    return n;
+}
+
+// 用 data 整体替换文件内容：从头覆盖写入后截断到写入的长度，已有的数据块原地改写，不必先全部释放再重新分配
+// 开始之前先预留需要新分配的块，空间不足时直接失败，文件保持原内容不变；
+// 新内容不超过 WRITE_TXN_BLOCKS 块时数据也写进日志，写入和截断作为一个事务提交，崩溃后文件要么是旧内容要么是新内容，
+// 更大的内容放不进一条日志记录，分段写入后再截断，崩溃后可能是新旧内容的混合
+int64_t FileManager::Overwrite(int fd, const char *data, uint32_t len)
+{
+    OpenFile *file = GetOpenFile(fd);
+    if (file == nullptr)
+        return -1;
+    if ((file->flags & OPEN_WRITE) == 0)
+    {
+        SessionErr() << "错误：文件描述符 " << fd << " 不是以写方式打开的！" << std::endl;
+        return -1;
     }
-    // 2. 清理旧块 (假设 write 是覆盖式写入)
-    for (int i = 0; i < 10; ++i)
+    // 1. 预留新内容还缺的块（内联文件写入后仍放得下时不需要块）
+    uint32_t blocks = (uint32_t)(((uint64_t)len + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    bool staysInline = (file->node->flags & INODE_INLINE) && len <= INLINE_DATA_SIZE;
+    if (!staysInline && !disk->ReserveBlocks(file->mapper->MissingBlocks(blocks)))
     {
-        if (node.direct_ptr[i] != 0)
+        SessionErr() << "错误：磁盘空间不足，文件保持原内容！" << std::endl;
+        return -1;
+    }
+    // 2. 覆盖写入并截断
+    int64_t n;
+    {
+        std::unique_ptr<Transaction> txn(blocks <= WRITE_TXN_BLOCKS ? new Transaction(disk, blocks) : nullptr);
+        n = WriteRange(file->inode_id, *file->node, *file->mapper, 0, data, len);
+        if (n >= 0 && !TruncateRange(file->inode_id, *file->node, *file->mapper, (uint32_t)n))
+            n = -1;
+    }
+    disk->ReleaseReservation();
+    if (n < 0)
+        return -1;
+    file->offset = (uint32_t)n;
+    return n;
+}
+
+// 移动读写位置，whence 取 SEEK_SET / SEEK_CUR / SEEK_END；允许越过文件末尾，之后写入时中间留作空洞
+// 返回新的位置，失败返回 -1
+int64_t FileManager::Seek(int fd, int64_t offset, int whence)
+{
+    OpenFile *file = GetOpenFile(fd);
+    if (file == nullptr)
+        return -1;
+    int64_t base = (whence == SEEK_CUR) ? file->offset : (whence == SEEK_END) ? file->node->size : 0;
+    int64_t pos = base + offset;
+    if (pos < 0 || pos > UINT32_MAX)
+    {
+        SessionErr() << "错误：无效的文件位置！" << std::endl;
+        return -1;
+    }
+    file->offset = (uint32_t)pos;
+    return pos;
+}
+
+// 把文件从当前位置到末尾的内容直接写到 outFd：块缓存（或映射区）中的数据不经过中间缓冲区，
+// 块指针直接交给 writev，每批最多 STREAM_BATCH_BLOCKS 块，内存占用与文件大小无关；返回写出的字节数，失败返回 -1
+int64_t FileManager::SendFile(int fd, int outFd)
+{
+    OpenFile *file = GetOpenFile(fd);
+    if (file == nullptr)
+        return -1;
+    static const char zeroBlock[BLOCK_SIZE] = {0}; // 空洞输出为 0
+    const Inode &node = *file->node;
+    int64_t total = 0;
+    // 内联文件的内容就在 Inode 中，直接写出
+    if ((node.flags & INODE_INLINE) && file->offset < node.size)
+    {
+        const char *data = reinterpret_cast<const char *>(node.direct_ptr) + file->offset;
+        uint32_t len = node.size - file->offset;
+#ifdef _WIN32
+        SessionOut().write(data, len);
+#else
+        struct iovec iov = {const_cast<char *>(data), len};
+        if (!WriteVector(outFd, &iov, 1))
         {
-            disk->FreeBlock(node.direct_ptr[i]);
-            node.direct_ptr[i] = 0;
+            SessionErr() << "错误：写出数据失败！" << std::endl;
+            return -1;
         }
+#endif
+        file->offset = node.size;
+        return len;
     }
-    // 3. 计算所需块数并分配
-    size_t contentLen = content.length();
-    uint32_t numBlocks = (contentLen + BLOCK_SIZE - 1) / BLOCK_SIZE;
-    if (numBlocks > 10)
+    while (file->offset < node.size)
     {
-        std::cerr << "错误：内容过大，超出直接索引限制！" << std::endl;
-        return false;
+        // 1. 先解析这一批块的映射（可能读入间接块），再取块指针，保证指针在写出之前不会被淘汰
+        uint32_t first = file->offset / BLOCK_SIZE;
+        uint32_t last = std::min((node.size - 1) / BLOCK_SIZE, first + STREAM_BATCH_BLOCKS - 1);
+        uint32_t phys[STREAM_BATCH_BLOCKS];
+        for (uint32_t b = first; b <= last; ++b)
+            phys[b - first] = file->mapper->Map(b);
+        // 2. 每块只取有效的字节范围：首块从当前位置开始，末块截到文件末尾
+#ifndef _WIN32
+        struct iovec iov[STREAM_BATCH_BLOCKS];
+#endif
+        uint32_t bytes = 0;
+        for (uint32_t b = first; b <= last; ++b)
+        {
+            const char *data = (phys[b - first] != 0) ? disk->PeekBlock(phys[b - first]) : zeroBlock;
+            if (data == nullptr)
+            {
+                SessionErr() << "错误：读取数据块失败！" << std::endl;
+                return -1;
+            }
+            uint32_t start = (b == first) ? file->offset % BLOCK_SIZE : 0;
+            uint32_t end = std::min<uint32_t>(BLOCK_SIZE, node.size - b * BLOCK_SIZE);
+#ifdef _WIN32
+            SessionOut().write(data + start, end - start);
+#else
+            iov[b - first].iov_base = const_cast<char *>(data + start);
+            iov[b - first].iov_len = end - start;
+#endif
+            bytes += end - start;
+        }
+#ifndef _WIN32
+        // 3. 整批一次 writev 写出
+        if (!WriteVector(outFd, iov, last - first + 1))
+        {
+            SessionErr() << "错误：写出数据失败！" << std::endl;
+            return -1;
+        }
+#endif
+        file->offset += bytes;
+        total += bytes;
     }
-    // 4. 写入数据
-    for (uint32_t i = 0; i < numBlocks; ++i)
+    return total;
+}
+
+#ifndef _WIN32
+// 把 iov 描述的全部数据写到 outFd，处理部分写入和信号中断
+bool FileManager::WriteVector(int outFd, struct iovec *iov, int count)
+{
+    while (count > 0)
     {
-        uint32_t newBlockId = disk->AllocateBlock();
-        if (newBlockId == (uint32_t)-1)
+        ssize_t n = writev(outFd, iov, count);
+        if (n < 0)
         {
-            std::cerr << "错误：磁盘空间不足！" << std::endl;
+            if (errno == EINTR)
+                continue;
             return false;
         }
-        node.direct_ptr[i] = newBlockId;
-        // 填充缓冲区并写入
-        char buffer[BLOCK_SIZE] = {0};
-        size_t offset = i * BLOCK_SIZE;
-        size_t toWrite = std::min((size_t)BLOCK_SIZE, contentLen - offset);
-        memcpy(buffer, content.c_str() + offset, toWrite);
-        disk->WriteBlock(newBlockId, buffer);
-    }
-    // 5. 更新 Inode 元数据
-    node.size = contentLen;
-    return disk->WriteInode(inodeId, node);
-}
-
-// 读取文件内容并返回字符串
-std::string FileManager::ReadFile(const std::string &name)
-{
-    // 1. 在当前目录下查找文件 Inode ID
-    uint32_t inodeId = dir->FindInodeId(name, currentInodeId);
-    if (inodeId == (uint32_t)-1)
-        return "错误：文件不存在!";
-    // 2. 读取 Inode 元数据
-    Inode node;
-    if (!disk->ReadInode(inodeId, node))
-        return "错误：无法读取 Inode!";
-    // 3. 根据 size 循环读取物理块
-    std::string result = "";
-    uint32_t remainingSize = node.size;
-    char buffer[BLOCK_SIZE];
-    for (int i = 0; i < 10 && remainingSize > 0; ++i)
-    {
-        uint32_t physBlockId = node.direct_ptr[i];
+        // 跳过已经写完的段，剩余部分从中断处继续
+        while (count > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+#endif
+
+// 按描述符取得打开的文件，描述符无效时返回空
+FileManager::OpenFile *FileManager::GetOpenFile(int fd)
+{
+    if (fd < 0 || fd >= (int)openFiles.size() || openFiles[fd] == nullptr)
+    {
+        SessionErr() << "错误：无效的文件描述符 " << fd << "！" << std::endl;
+        return nullptr;
+    }
+    return openFiles[fd].get();
+}
+
+// 从 offset 处读取最多 len 字节到 buf，只读取涉及的块；返回实际读取的字节数，失败返回 -1
+int64_t FileManager::ReadAt(uint32_t inodeId, uint32_t offset, uint32_t len, char *buf)
+{
+    Inode *node = PinFile(inodeId);
+    if (node == nullptr)
+        return -1;
+    int64_t n;
+    {
+        BlockMapper mapper(disk, *node);
+        n = ReadRange(*node, mapper, offset, len, buf);
+    }
+    disk->UnpinInode(inodeId);
+    return n;
+}
+
+// 把 len 字节写到文件的 offset 处，只改写涉及的块；返回实际写入的字节数，失败返回 -1
+int64_t FileManager::WriteAt(uint32_t inodeId, uint32_t offset, const char *data, uint32_t len)
+{
+    Inode *node = PinFile(inodeId);
+    if (node == nullptr)
+        return -1;
+    int64_t n;
+    {
+        BlockMapper mapper(disk, *node);
+        n = WriteRange(inodeId, *node, mapper, offset, data, len);
+    }
+    disk->UnpinInode(inodeId);
+    return n;
+}
+
+// 在文件末尾追加内容，返回实际写入的字节数，失败返回 -1
+int64_t FileManager::Append(uint32_t inodeId, const char *data, uint32_t len)
+{
+    Inode *node = PinFile(inodeId);
+    if (node == nullptr)
+        return -1;
+    int64_t n;
+    {
+        BlockMapper mapper(disk, *node);
+        n = WriteRange(inodeId, *node, mapper, node->size, data, len);
+    }
+    disk->UnpinInode(inodeId);
+    return n;
+}
+
+// 把文件截断（或用空洞扩展）到 newSize 字节
+bool FileManager::Truncate(uint32_t inodeId, uint32_t newSize)
+{
+    Inode *node = PinFile(inodeId);
+    if (node == nullptr)
+        return false;
+    bool ok;
+    {
+        BlockMapper mapper(disk, *node);
+        ok = TruncateRange(inodeId, *node, mapper, newSize);
+    }
+    disk->UnpinInode(inodeId);
+    return ok;
+}
+
+// 钉住一个普通文件的 Inode，不是普通文件时返回空
+Inode *FileManager::PinFile(uint32_t inodeId)
+{
+    Inode *node = disk->PinInode(inodeId);
+    if (node == nullptr)
+        return nullptr;
+    if ((node->mode >> 9) != TYPE_FILE)
+    {
+        disk->UnpinInode(inodeId);
+        SessionErr() << "错误：目标不是普通文件！" << std::endl;
+        return nullptr;
+    }
+    return node;
+}
+
+// 读取 [offset, offset + len) 中涉及的块，未分配的空洞读出为 0，范围截到文件末尾
+int64_t FileManager::ReadRange(const Inode &node, BlockMapper &mapper, uint32_t offset, uint32_t len, char *buf)
+{
+    if (offset >= node.size || len == 0)
+        return 0;
+    len = std::min(len, node.size - offset);
+    // 内联文件直接从 Inode 中拷贝，不读任何数据块
+    if (node.flags & INODE_INLINE)
+    {
+        memcpy(buf, reinterpret_cast<const char *>(node.direct_ptr) + offset, len);
+        return len;
+    }
+    // 1. 一次提交涉及的所有块的读请求，再统一等待
+    uint32_t first = offset / BLOCK_SIZE;
+    uint32_t last = (uint32_t)(((uint64_t)offset + len - 1) / BLOCK_SIZE);
+    std::vector<char> data((size_t)(last - first + 1) * BLOCK_SIZE, 0);
+    for (uint32_t b = first; b <= last; ++b)
+    {
+        uint32_t physBlockId = mapper.Map(b);
+        if (physBlockId != 0)
+            disk->SubmitRead(physBlockId, &data[(size_t)(b - first) * BLOCK_SIZE]);
+    }
+    if (!disk->Wait())
+    {
+        SessionErr() << "错误：读取数据块失败！" << std::endl;
+        return -1;
+    }
+    // 2. 拷出请求的字节范围
+    memcpy(buf, &data[offset - first * BLOCK_SIZE], len);
+    return len;
+}
+
+// 写入 [offset, offset + len)：按 WRITE_TXN_BLOCKS 个块一段拆开，每段是一个事务，
+// 数据块直接写到原位置，日志记录里只有这一段的元数据，再大的写入也不会因为放不进日志而退化为同步写回；
+// 崩溃后文件可能只包含前面已经提交的几段。已在外层事务中时各段合并进外层事务一起提交
+int64_t FileManager::WriteRange(uint32_t inodeId, Inode &node, BlockMapper &mapper, uint32_t offset, const char *data, uint32_t len)
+{
+    // 1. 检查大小上限
+    if (len == 0)
+        return 0;
+    uint64_t end = (uint64_t)offset + len;
+    if (end > (uint64_t)MAX_FILE_BLOCKS * BLOCK_SIZE || end > UINT32_MAX)
+    {
+        SessionErr() << "错误：内容过大，超出单个文件的大小上限！" << std::endl;
+        return -1;
+    }
+    // 2. 逐段写入，每段在块边界处结束；某段没有写完（空间不足）时停止
+    uint32_t done = 0;
+    while (done < len)
+    {
+        uint32_t pos = offset + done;
+        uint64_t segmentEnd = ((uint64_t)pos / BLOCK_SIZE + WRITE_TXN_BLOCKS) * BLOCK_SIZE;
+        uint32_t segment = (uint32_t)std::min<uint64_t>(len - done, segmentEnd - pos);
+        int64_t n = WriteSegment(inodeId, node, mapper, pos, data + done, segment);
+        if (n < 0)
+            return (done > 0) ? done : -1;
+        done += n;
+        if (n < segment)
+            break;
+    }
+    return done;
+}
+
+// 在一个事务中写入一段：首尾不完整的块先读出再合并，缺失的块就近分配
+// 写入位置超过文件末尾时，中间部分留作空洞；node 是缓存中钉住的 Inode，修改后标记为脏
+int64_t FileManager::WriteSegment(uint32_t inodeId, Inode &node, BlockMapper &mapper, uint32_t offset, const char *data, uint32_t len)
+{
+    // 分配、块映射和文件大小作为一个事务提交，数据块在提交之前已经写到原位置
+    Transaction txn(disk);
+    uint64_t end = (uint64_t)offset + len;
+    // 内联文件：写入后仍放得下时只修改 Inode，放不下时先把原内容迁移到数据块
+    if (node.flags & INODE_INLINE)
+    {
+        if (end <= INLINE_DATA_SIZE)
+        {
+            memcpy(reinterpret_cast<char *>(node.direct_ptr) + offset, data, len);
+            node.size = std::max<uint32_t>(node.size, end);
+            disk->MarkInodeDirty(inodeId);
+            return len;
+        }
+        if (!PromoteInline(inodeId, node, mapper))
+            return -1;
+    }
+    uint32_t first = offset / BLOCK_SIZE;
+    uint32_t last = (uint32_t)((end - 1) / BLOCK_SIZE);
+    std::vector<char> blocks((size_t)(last - first + 1) * BLOCK_SIZE, 0);
+    // 1. 首尾块只被覆盖一部分时，先读出原内容
+    uint32_t edges[2] = {first, last};
+    for (int k = 0; k < (first == last ? 1 : 2); ++k)
+    {
+        uint64_t blockStart = (uint64_t)edges[k] * BLOCK_SIZE;
+        bool partial = offset > blockStart || end < blockStart + BLOCK_SIZE;
+        uint32_t physBlockId = mapper.Map(edges[k]);
+        if (partial && physBlockId != 0)
+            disk->SubmitRead(physBlockId, &blocks[(size_t)(edges[k] - first) * BLOCK_SIZE]);
+    }
+    if (!disk->Wait())
+    {
+        SessionErr() << "错误：读取数据块失败！" << std::endl;
+        return -1;
+    }
+    memcpy(&blocks[offset - first * BLOCK_SIZE], data, len);
+    // 2. 逐块提交写请求，没有映射的块紧跟前一个块分配，尽量保持连续；文件的第一个块放在 Inode 所在的分配组
+    uint32_t prev = (first > 0) ? mapper.Map(first - 1) : 0;
+    uint32_t b = first;
+    for (; b <= last; ++b)
+    {
+        uint32_t physBlockId = mapper.Map(b);
         if (physBlockId == 0)
-            break; // 安全保护：不应该出现的空指针
-        disk->ReadBlock(physBlockId, buffer);
-        // 计算当前块中实际有效的数据长度
-        uint32_t bytesToRead = std::min((uint32_t)BLOCK_SIZE, remainingSize);
-        result.append(buffer, bytesToRead);
-        remainingSize -= bytesToRead;
+        {
+            int newBlockId = disk->AllocateExtent(1, prev != 0 ? prev + 1 : disk->GroupGoal(inodeId));
+            if (newBlockId == -1)
+            {
+                SessionErr() << "错误：磁盘空间不足！" << std::endl;
+                break;
+            }
+            // 超出直接索引的部分需要间接块，间接块也分配不到时同样视为空间不足
+            if (!mapper.Assign(b, newBlockId))
+            {
+                SessionErr() << "错误：磁盘空间不足！" << std::endl;
+                disk->FreeBlock(newBlockId);
+                break;
+            }
+            physBlockId = newBlockId;
+        }
+        disk->SubmitWrite(physBlockId, &blocks[(size_t)(b - first) * BLOCK_SIZE]);
+        prev = physBlockId;
+    }
+    bool ok = disk->Wait();
+    mapper.Flush();
+    // 3. 更新文件大小（空间不足时只算已经写入的部分，已分配的块也要记录下来，防止泄漏）
+    // 数据写入失败时已分配的块照样记录，文件大小不变
+    if (!ok)
+    {
+        disk->MarkInodeDirty(inodeId);
+        SessionErr() << "错误：写入数据块失败！" << std::endl;
+        return -1;
+    }
+    uint32_t written = (b > last) ? len : (uint32_t)(std::max<uint64_t>((uint64_t)b * BLOCK_SIZE, offset) - offset);
+    node.size = std::max(node.size, offset + written);
+    disk->MarkInodeDirty(inodeId);
+    return written;
+}
+
+// 截断到 newSize：只释放新末尾之后的块，并把最后一块的尾部清零；变长时新增部分是空洞
+bool FileManager::TruncateRange(uint32_t inodeId, Inode &node, BlockMapper &mapper, uint32_t newSize)
+{
+    // 整个操作作为一个事务提交，崩溃后要么全部生效要么全部不生效
+    Transaction txn(disk);
+    // 内联文件：内联区内超出文件大小的部分保持为 0；扩展到放不下时先迁移到数据块
+    if (node.flags & INODE_INLINE)
+    {
+        if (newSize <= INLINE_DATA_SIZE)
+        {
+            if (newSize < node.size)
+                memset(reinterpret_cast<char *>(node.direct_ptr) + newSize, 0, node.size - newSize);
+            node.size = newSize;
+            disk->MarkInodeDirty(inodeId);
+            return true;
+        }
+        if (!PromoteInline(inodeId, node, mapper))
+            return false;
+    }
+    if (newSize < node.size)
+    {
+        // 1. 解除新末尾之后所有块的映射
+        std::vector<uint32_t> freed;
+        uint32_t keep = (newSize + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        mapper.Release(keep, freed);
+        // 2. 最后一块只保留一部分时把尾部清零，之后再扩展时不会读出旧数据
+        uint32_t physBlockId = (newSize % BLOCK_SIZE != 0) ? mapper.Map(keep - 1) : 0;
+        if (physBlockId != 0)
+        {
+            char buffer[BLOCK_SIZE];
+            if (disk->ReadBlock(physBlockId, buffer))
+            {
+                memset(buffer + newSize % BLOCK_SIZE, 0, BLOCK_SIZE - newSize % BLOCK_SIZE);
+                disk->WriteBlock(physBlockId, buffer);
+            }
+        }
+        mapper.Flush();
+        // 3. 归还释放的块
+        FreeBlockList(freed);
+    }
+    // 截断为空且不再占用任何块时恢复为内联存放
+    if (newSize == 0 && node.block_count == 0)
+        node.flags |= INODE_INLINE;
+    node.size = newSize;
+    disk->MarkInodeDirty(inodeId);
+    return true;
+}
+
+// 把内联存放的内容迁移到数据块，之后按普通文件处理
+bool FileManager::PromoteInline(uint32_t inodeId, Inode &node, BlockMapper &mapper)
+{
+    char saved[INLINE_DATA_SIZE];
+    memcpy(saved, node.direct_ptr, INLINE_DATA_SIZE);
+    uint32_t oldSize = node.size;
+    memset(node.direct_ptr, 0, sizeof(node.direct_ptr));
+    node.flags &= ~INODE_INLINE;
+    node.size = 0;
+    disk->MarkInodeDirty(inodeId);
+    if (oldSize == 0)
+        return true;
+    return WriteRange(inodeId, node, mapper, 0, saved, oldSize) == (int64_t)oldSize;
+}
+
+// 释放 Inode 占用的全部数据块和间接块
+void FileManager::FreeDataBlocks(Inode &node)
+{
+    std::vector<uint32_t> blocks;
+    {
+        BlockMapper mapper(disk, node);
+        mapper.CollectBlocks(blocks);
+    }
+    memset(node.direct_ptr, 0, sizeof(node.direct_ptr));
+    node.single_indirect = 0;
+    node.double_indirect = 0;
+    node.dir_index_start = 0;
+    node.dir_index_blocks = 0;
+    node.dir_index_used = 0;
+    FreeBlockList(blocks);
+    node.block_count = 0;
+}
+
+// 归还一组块，相邻的块合并成一次 FreeExtent
+void FileManager::FreeBlockList(std::vector<uint32_t> &blocks)
+{
+    std::sort(blocks.begin(), blocks.end());
+    for (size_t i = 0; i < blocks.size();)
+    {
+        size_t j = i + 1;
+        while (j < blocks.size() && blocks[j] == blocks[j - 1] + 1)
+            ++j;
+        disk->FreeExtent(blocks[i], j - i);
+        i = j;
     }
-    return result;
 }
 
 // 判断用户是否具有指定权限
@@ -344,19 +878,25 @@ bool FileManager::HasPermission(uint32_t inodeId, int requiredPerm, const User &
     // 1. Root 用户 (UID 0) 拥有绝对权限
     if (user.groupId == GID_ROOT)
         return true;
-    Inode node;
-    if (!disk->ReadInode(inodeId, node))
+    // 直接访问缓存中的 Inode，避免整块拷贝
+    const Inode *node = disk->PinInode(inodeId);
+    if (node == nullptr)
         return false;
     // 2. 提取权限位
-    uint32_t mode = node.mode & PERM_MASK;
+    uint32_t mode = node->mode & PERM_MASK;
     uint32_t ownerPerm = (mode >> 6) & 07;
     uint32_t groupPerm = (mode >> 3) & 07;
     uint32_t otherPerm = mode & 07;
     // 3. 判定身份并校验
-    if (node.owner_id == user.userId)
-        return (ownerPerm & requiredPerm) == requiredPerm;
-    else if (node.group_id == user.groupId)
-        return (groupPerm & requiredPerm) == requiredPerm;
+    bool granted;
+    if (node->owner_id == (uint32_t)user.userId)
+        granted = (ownerPerm & requiredPerm) == (uint32_t)requiredPerm;
+    else if (node->group_id == (uint32_t)user.groupId)
+        granted = (groupPerm & requiredPerm) == (uint32_t)requiredPerm;
     else
-        return (otherPerm & requiredPerm) == requiredPerm;
-}
\ No newline at end of file
+        granted = (otherPerm & requiredPerm) == (uint32_t)requiredPerm;
+    disk->UnpinInode(inodeId);
+    return granted;
+}
+
+} // namespace FS_NAMESPACE
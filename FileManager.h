@@ -2,30 +2,77 @@
 #define FILE_MANAGER_H
 
 #include "DiskManager.h"
+#include "BlockMapper.h"
 #include "FileSystem.h"
 #include "DirectoryManager.h"
+#include "LockManager.h"
+
+namespace FS_NAMESPACE
+{
 
 class FileManager
 {
 private:
+    // 打开的文件：钉住的 Inode、块映射和访问权在打开期间一直保留
+    struct OpenFile
+    {
+        uint32_t inode_id = 0;               // 文件的 Inode 编号
+        Inode *node = nullptr;               // 缓存中钉住的 Inode
+        std::unique_ptr<BlockMapper> mapper; // 已解析的块映射
+        int flags = 0;                       // 打开方式 (OpenFlag)
+        uint32_t offset = 0;                 // 当前读写位置
+    };
+
     DiskManager *disk;       // 引用底层的磁盘管理器
     DirectoryManager *dir;   // 引用底层的目录管理器
     SystemContext *ctx;      // 系统上下文
+    LockManager *locks;      // 文件访问权管理
     uint32_t currentInodeId; // 记录当前所在目录的 Inode 编号
+    std::vector<std::string> cwdComponents; // 当前目录从根开始的各级名字
+    std::string cwdPath;                    // 当前目录的绝对路径（缓存）
+    std::vector<std::unique_ptr<OpenFile>> openFiles; // 打开文件表，下标即文件描述符
+
+    void FreeDataBlocks(Inode &node);
+    void FreeBlockList(std::vector<uint32_t> &blocks);
+    OpenFile *GetOpenFile(int fd);
+#ifndef _WIN32
+    static bool WriteVector(int outFd, struct iovec *iov, int count);
+#endif
+    Inode *PinFile(uint32_t inodeId);
+    int64_t ReadRange(const Inode &node, BlockMapper &mapper, uint32_t offset, uint32_t len, char *buf);
+    int64_t WriteRange(uint32_t inodeId, Inode &node, BlockMapper &mapper, uint32_t offset, const char *data, uint32_t len);
+    int64_t WriteSegment(uint32_t inodeId, Inode &node, BlockMapper &mapper, uint32_t offset, const char *data, uint32_t len);
+    bool TruncateRange(uint32_t inodeId, Inode &node, BlockMapper &mapper, uint32_t newSize);
+    bool PromoteInline(uint32_t inodeId, Inode &node, BlockMapper &mapper);
 
 public:
-    FileManager(DiskManager *dm, DirectoryManager *dirm, SystemContext *ctx);
+    FileManager(DiskManager *dm, DirectoryManager *dirm, SystemContext *ctx, LockManager *lm);
+    ~FileManager();
 
     bool CreateFile(const std::string &name, uint32_t customPerm);
     bool DeleteFile(const std::string &name);
     uint32_t GetCurrentInodeId();
     bool MakeDirectory(const std::string &name, uint32_t customPerm = 0);
+    bool ResolvePath(const std::string &path, uint32_t &inodeId, std::vector<std::string> *components = nullptr);
     bool ChangeDirectory(const std::string &path);
     std::string GetAbsolutePath();
     bool TouchFile(const std::string &name, uint32_t customPerm = 0);
-    bool WriteFile(const std::string &name, const std::string &content);
-    std::string ReadFile(const std::string &name);
+    int Open(const std::string &path, int flags);
+    bool Close(int fd);
+    bool Fsync(int fd);
+    void CloseAll();
+    int64_t Read(int fd, char *buf, uint32_t len);
+    int64_t Write(int fd, const char *data, uint32_t len);
+    int64_t Overwrite(int fd, const char *data, uint32_t len);
+    int64_t Seek(int fd, int64_t offset, int whence);
+    int64_t SendFile(int fd, int outFd);
+    int64_t ReadAt(uint32_t inodeId, uint32_t offset, uint32_t len, char *buf);
+    int64_t WriteAt(uint32_t inodeId, uint32_t offset, const char *data, uint32_t len);
+    int64_t Append(uint32_t inodeId, const char *data, uint32_t len);
+    bool Truncate(uint32_t inodeId, uint32_t newSize);
     bool HasPermission(uint32_t inodeId, int requiredPerm, const User &user);
 };
 
-#endif
\ No newline at end of file
+} // namespace FS_NAMESPACE
+
+#endif
@@ -14,20 +14,87 @@
 #include <iomanip>
 #include <thread>
 #include <chrono>
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <cerrno>
+#include <climits>
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#ifdef __linux__
+// linux/fs.h 自带同名的 BLOCK_SIZE 宏，必须先于下面的定义包含并取消定义
+#include <linux/io_uring.h>
+#undef BLOCK_SIZE
+#endif
 
 // --- 基础常量定义 ---
-#define BLOCK_SIZE 512
-#define TOTAL_BLOCKS 32768
-#define BITMAP_SIZE 8
-#define INODES_PER_BLOCK 4
+// 块大小在编译期确定，块内偏移的计算都能编译成移位和掩码；程序里同时编译了 512 和 4096 两份：
+// 各模块自己的编译单元是 512 字节块，FileSystem4096.cpp 以 FS_BLOCK_SIZE=4096 把全部模块再编译一遍，
+// 两份代码分别在 fs512 和 fs4096 命名空间里，main 按镜像超级块中记录的块大小进入其中一份
+#ifndef FS_BLOCK_SIZE
+#define FS_BLOCK_SIZE 512
+#endif
+#define BLOCK_SIZE FS_BLOCK_SIZE
+#define FS_NAMESPACE_OF(bs) FS_NAMESPACE_JOIN(fs, bs)
+#define FS_NAMESPACE_JOIN(prefix, bs) prefix##bs
+#define FS_NAMESPACE FS_NAMESPACE_OF(FS_BLOCK_SIZE) // 当前块大小对应的命名空间：fs512 或 fs4096
+
+namespace FS_NAMESPACE
+{
+#define TOTAL_BLOCKS 32768        // 格式化时的默认总块数
+#define DEFAULT_INODE_COUNT 4096  // 格式化时的默认 Inode 数
+#define BITMAP_SIZE 8             // 旧镜像的位图块数
+#define INODES_PER_BLOCK (BLOCK_SIZE / 128)
 #define DIR_ENTRY_SIZE 32
+#define CACHE_CAPACITY 256       // 块缓存容量（块数），256 块 = 128KB
+#define INODE_CACHE_CAPACITY 512 // Inode 缓存容量（个数）
+#define DENTRY_CACHE_CAPACITY 2048 // 目录项缓存容量（条数，含否定项）
+#define DIR_READAHEAD_BLOCKS 8     // 读目录时一次批量读入的块数
+#define URING_QUEUE_DEPTH 64     // io_uring 默认队列深度
+#define JOURNAL_BLOCKS 256       // 新格式化镜像的日志区块数
+#define MAX_OPEN_FILES 64        // 每个 FileManager 最多同时打开的文件数
+#define LOCK_SHARDS 16           // 锁表的分片数，按 Inode 编号分散到各片，每片一把互斥锁
+#define LOCK_POLL_MS 10          // 等待其他进程释放镜像上的字节范围锁时的轮询间隔（毫秒）
+#define SERVER_WORKERS 4         // 服务模式下默认的工作线程数
+#define SERVER_MAX_LINE 65536    // 服务模式下单条命令的最大长度（字节）
+#define STREAM_BATCH_BLOCKS 16   // 流式输出时一次 writev 的最多块数，须远小于 CACHE_CAPACITY
+#define GROUP_BLOCKS (BLOCK_SIZE * 8) // 每个分配组的块数：一个位图块恰好记录一组
+#define PEEK_WINDOW 32           // 每个线程最近 PeekBlock 过的块数，这些块的指针保持有效，须不小于 STREAM_BATCH_BLOCKS
+#define FLUSH_INTERVAL_MS 1000   // 定期写回策略下后台线程的默认写回间隔（毫秒）
+#define WRITE_TXN_BLOCKS 64      // 大块写入拆成多个事务，每个事务最多写入的数据块数，元数据记录始终放得进日志
+#define TXN_META_BLOCKS 16       // 一个事务句柄预计暂存的元数据块数，用来估算运行中的事务还能并入多少句柄
 
-const uint32_t INODE_BITMAP_BYTES = 512;
-const uint32_t INODE_BITMAP_START_BYTE = 1;
+const uint32_t DIRECT_BLOCKS = 10;                       // 直接索引块数
+const uint32_t PTRS_PER_BLOCK = BLOCK_SIZE / 4;          // 一个间接块能存放的块号数
+const uint32_t MAX_FILE_BLOCKS = DIRECT_BLOCKS + PTRS_PER_BLOCK + PTRS_PER_BLOCK * PTRS_PER_BLOCK; // 单个文件最多的数据块数
+const uint32_t INODE_INLINE = 1;                                // Inode 标志：文件内容内联存放在直接索引区中
+const uint32_t INLINE_DATA_SIZE = DIRECT_BLOCKS * sizeof(uint32_t); // 内联存放的最大字节数
+const uint32_t INODE_BITMAP_BYTES = 512;     // 旧镜像的 Inode 位图字节数
+const uint32_t INODE_BITMAP_START_BYTE = 1;  // 旧镜像的 Inode 位图在位图区内的起始字节
 const int GID_ROOT = 0;               // 管理员组：拥有最高权限
 const int GID_USERS = 1;              // 普通用户组：所有标准用户默认所属
 const int GID_GUEST = 2;              // 访客组：受限权限
@@ -38,6 +105,16 @@ const uint32_t ROOT_DIR_MODE = 0755;  // rwxr-xr-x
 const uint32_t ROOT_FILE_MODE = 0644; // rw-r--r--
 const uint32_t PERM_MASK = 0777;      // 权限掩码
 const std::string VDISK_PATH = "vdisk.img";
+const std::string SERVER_SOCKET_PATH = "fs.sock"; // 服务模式默认的 Unix 套接字路径
+
+// 打开文件的方式，可以按位组合
+enum OpenFlag
+{
+    OPEN_READ = 1,   // 只读
+    OPEN_WRITE = 2,  // 读写，持有写访问权
+    OPEN_TRUNC = 4,  // 打开时清空文件
+    OPEN_APPEND = 8  // 每次写入都追加到文件末尾
+};
 
 // 权限常量
 enum Permission
@@ -47,6 +124,29 @@ enum Permission
     PERM_X = 1
 };
 
+// 块设备后端类型
+enum DiskBackend
+{
+    BACKEND_STREAM, // std::fstream，可移植
+    BACKEND_POSIX,  // pread/pwrite，仅限 POSIX 系统
+    BACKEND_MMAP,   // 整个镜像内存映射，仅限 POSIX 系统
+    BACKEND_URING   // io_uring 异步批量读写，仅限 Linux
+};
+
+// 持久化策略：决定已提交的操作什么时候真正落到磁盘上
+enum DurabilityPolicy
+{
+    DURABILITY_ALWAYS,   // 每次提交都刷新日志，操作返回即持久
+    DURABILITY_PERIODIC, // 提交只写日志不刷新，后台线程定期刷新日志并写回脏块，最多丢失一个间隔内的操作
+    DURABILITY_MANUAL    // 只在 sync/fsync、卸载、缓存淘汰脏块或日志写满时刷新
+};
+
+#ifdef _WIN32
+const DiskBackend DEFAULT_BACKEND = BACKEND_STREAM;
+#else
+const DiskBackend DEFAULT_BACKEND = BACKEND_POSIX;
+#endif
+
 // 用户结构体
 struct User
 {
@@ -54,7 +154,7 @@ struct User
     int groupId;
 };
 
-// 超级块结构：占用 1 个块 (512B)，实际只用了前面一部分
+// 超级块结构：占用 1 个块，实际只用了前面一部分
 struct SuperBlock
 {
     uint32_t total_blocks; // 总块数
@@ -64,7 +164,18 @@ struct SuperBlock
     uint32_t inode_start;  // Inode区起始块号
     uint32_t data_start;   // 数据区起始块号
 
-    char padding[488]; // 填充至 512 字节
+    uint32_t next_free_block; // 最近一次块分配所在组的游标，挂载时恢复该组的游标并作为分配的首选组
+    uint32_t next_free_inode; // 最近一次 Inode 分配所在组的游标，挂载时恢复该组的游标
+
+    uint32_t journal_start;  // 日志区起始块号
+    uint32_t journal_blocks; // 日志区块数，0 表示没有日志（旧镜像）
+
+    uint32_t block_size;          // 块大小（字节），0 表示旧镜像：512 字节块、固定布局
+    uint32_t inode_count;         // Inode 总数
+    uint32_t bitmap_blocks;       // 位图区块数（块位图 + Inode 位图）
+    uint32_t inode_bitmap_offset; // Inode 位图在位图区内的起始字节
+
+    char padding[BLOCK_SIZE - 52]; // 填充至一个块
 };
 
 // Inode 结构：占用 1 个块 (128B)，实际只用了前面一部分
@@ -77,9 +188,85 @@ struct Inode
     uint32_t size;           // 文件大小（字节）
     uint32_t block_count;    // 已占用的数据块数量
     uint32_t direct_ptr[10]; // 直接索引：记录该文件占用的物理块号
-    int32_t reader_count;    // 当前读者数量
-    int32_t is_writing;      // 0: 空闲, 1: 正在写入/删除
-    char padding[56];        // 填充至 128 字节
+    int32_t reader_count;    // 已废弃：旧版本在此记录读者数量，现在锁状态只保存在内存中
+    int32_t is_writing;      // 已废弃：旧版本在此记录写状态，旧镜像中可能残留非 0 值，不再读取
+    uint32_t single_indirect; // 一级间接块：存放 PTRS_PER_BLOCK 个数据块号，0 表示未分配
+    uint32_t double_indirect; // 二级间接块：存放 PTRS_PER_BLOCK 个一级间接块号，0 表示未分配
+    uint32_t dir_index_start;  // 目录哈希索引的起始块（一段连续块），仅目录使用
+    uint32_t dir_index_blocks; // 目录哈希索引的块数，0 表示没有索引
+    uint32_t dir_index_used;   // 已占用的索引槽位数（有效 + 已删除标记）
+    uint32_t flags;            // Inode 标志 (INODE_INLINE 等)，旧镜像中为 0
+    char padding[32];          // 填充至 128 字节
+};
+
+static_assert((BLOCK_SIZE & (BLOCK_SIZE - 1)) == 0 && BLOCK_SIZE >= 512, "块大小必须是不小于 512 的 2 的幂");
+static_assert(sizeof(SuperBlock) == BLOCK_SIZE, "超级块必须正好占用一个块");
+static_assert(sizeof(Inode) * INODES_PER_BLOCK == BLOCK_SIZE, "Inode 必须正好填满 Inode 块");
+
+// 磁盘几何参数：块大小是模板参数，每块 Inode 数、每块位数等派生量都是编译期常量；
+// 总块数和 Inode 数在格式化时给定，连同推导出的各区位置一起写入超级块
+template <uint32_t BS>
+struct DiskGeometry
+{
+    static constexpr uint32_t block_size = BS;
+    static constexpr uint32_t inodes_per_block = BS / sizeof(Inode);
+    static constexpr uint32_t bits_per_block = BS * 8;
+
+    uint32_t total_blocks = TOTAL_BLOCKS;       // 总块数
+    uint32_t inode_count = DEFAULT_INODE_COUNT; // Inode 总数
+
+    // 位图区先存放块位图，紧接着是 Inode 位图，两者互不重叠
+    uint32_t InodeBitmapOffset() const { return (total_blocks + 7) / 8; }
+    uint32_t BitmapBlocks() const { return (InodeBitmapOffset() + (inode_count + 7) / 8 + BS - 1) / BS; }
+    uint32_t InodeBlocks() const { return (inode_count + inodes_per_block - 1) / inodes_per_block; }
+    uint32_t InodeStart() const { return 1 + BitmapBlocks(); }
+    uint32_t JournalStart() const { return InodeStart() + InodeBlocks(); }
+    uint32_t DataStart() const { return JournalStart() + JOURNAL_BLOCKS; }
+    bool Valid() const { return inode_count > 0 && (uint64_t)DataStart() < total_blocks; }
+};
+using Geometry = DiskGeometry<BLOCK_SIZE>;
+
+// 目录哈希索引的槽位：entry 为目录项下标 + 1，0 表示空槽，DIR_INDEX_DELETED 表示已删除
+struct DirIndexSlot
+{
+    uint32_t hash;  // 文件名的哈希值
+    uint32_t entry; // 目录项下标 + 1
+};
+const uint32_t DIR_INDEX_EMPTY = 0;
+const uint32_t DIR_INDEX_DELETED = 0xFFFFFFFF;
+const uint32_t DIR_INDEX_SLOTS_PER_BLOCK = BLOCK_SIZE / sizeof(DirIndexSlot);
+
+// 日志记录标识
+const uint32_t JOURNAL_HEADER_MAGIC = 0x4A534648; // "HFSJ"
+const uint32_t JOURNAL_DESC_MAGIC = 0x4A534644;   // "DFSJ"
+const uint32_t JOURNAL_COMMIT_MAGIC = 0x4A534643; // "CFSJ"
+const uint32_t JOURNAL_DESC_CAPACITY = (BLOCK_SIZE - 12) / 4; // 一个事务最多记录的块数
+
+// 日志头：日志区第 0 块，记录重放的起点
+struct JournalHeader
+{
+    uint32_t magic;    // JOURNAL_HEADER_MAGIC
+    uint32_t sequence; // start 处第一个事务的序号
+    uint32_t start;    // 第一个未检查点的事务在日志区内的块偏移
+    char padding[BLOCK_SIZE - 12];
+};
+
+// 事务开始记录（描述块）：列出随后各数据块的目标块号
+struct JournalDescriptor
+{
+    uint32_t magic;    // JOURNAL_DESC_MAGIC
+    uint32_t sequence; // 事务序号
+    uint32_t count;    // 随后记录的块数
+    uint32_t block_ids[JOURNAL_DESC_CAPACITY];
+};
+
+// 事务提交记录：校验和覆盖描述块中的块号和所有数据块，用于识别写了一半的事务
+struct JournalCommit
+{
+    uint32_t magic;    // JOURNAL_COMMIT_MAGIC
+    uint32_t sequence; // 事务序号
+    uint32_t checksum; // 校验和
+    char padding[BLOCK_SIZE - 12];
 };
 
 // 目录项结构：正好 32 字节，一块 (512B) 可存 16 个
@@ -89,11 +276,95 @@ struct DirEntry
     uint32_t inode_id; // 对应 Inode 编号
 };
 
-// 文件访问状态结构体
+// 文件访问状态结构体：LockManager 中每个被访问的 Inode 一项，只存在于内存
 struct FileAccessStatus
 {
     int reader_count = 0;    // 当前读者数量
     bool is_writing = false; // 是否正在被写（包括删除）
+    int waiting = 0;         // 正在等待的线程数
+    int writers_waiting = 0; // 其中等待写的线程数，大于 0 时新的读者让路，避免写者饿死
+    int image_lock = 0;      // 本进程在镜像上持有的字节范围锁：0 无，1 共享，2 独占
+};
+
+// 缓存块结构：块缓存中的一个槽位
+struct CacheBlock
+{
+    uint32_t block_id;             // 对应的物理块号
+    bool dirty = false;            // 是否被修改过但尚未写回磁盘
+    bool loading = false;          // 正在从磁盘读入，其他线程要等读完再访问
+    bool flushing = false;         // 正在被 Sync 写回，不能淘汰
+    std::shared_ptr<char[]> buffer; // 块数据的存储，PeekBlock 的调用线程也持有引用，淘汰后才不会悬空
+    char *data = nullptr;          // 块数据 (指向 buffer)
+};
+
+// Inode 缓存项：常驻内存的 Inode 及其引用计数
+struct InodeCacheEntry
+{
+    Inode node;        // Inode 内容
+    int ref_count = 0; // 引用（钉住）计数，大于 0 时不可被淘汰
+    bool dirty = false; // 是否被修改过但尚未写回 Inode 块
+};
+
+// 已提交但尚未完成的异步读请求
+struct PendingRead
+{
+    uint32_t block_id; // 物理块号
+    char *buffer;      // 调用者的目标缓冲区
+};
+
+// 缓存统计结构体：用于评估缓存容量是否合适
+struct CacheStats
+{
+    uint64_t hits = 0;       // 命中次数
+    uint64_t misses = 0;     // 未命中次数
+    uint64_t writebacks = 0; // 写回磁盘的块数
+};
+
+// 目录读取游标：按块批量读入目录，逐块返回目录项，可以从任意目录项下标处继续
+struct DirCursor
+{
+    uint32_t dir_inode_id = 0; // 被读取的目录
+    Inode node;                // 打开时的目录 Inode
+    uint32_t offset = 0;       // 下一个要返回的目录项下标
+    uint32_t entry_count = 0;  // 打开时的目录项总数
+    uint32_t batch_first = 0;  // 批量缓冲区中第一个块的逻辑块号
+    uint32_t batch_blocks = 0; // 批量缓冲区中的块数
+    std::vector<char> batch;   // 批量缓冲区
+};
+
+// 目录项缓存的键：(父目录 Inode, 文件名)
+struct DentryKey
+{
+    uint32_t parent;
+    std::string name;
+    bool operator==(const DentryKey &other) const { return parent == other.parent && name == other.name; }
+};
+
+struct DentryKeyHash
+{
+    size_t operator()(const DentryKey &key) const
+    {
+        return std::hash<std::string>()(key.name) ^ ((size_t)key.parent * 0x9E3779B97F4A7C15ULL);
+    }
+};
+
+// 目录项缓存统计
+struct DentryStats
+{
+    uint64_t hits = 0;          // 命中次数（含否定项）
+    uint64_t negative_hits = 0; // 命中否定项（名字不存在）的次数
+    uint64_t misses = 0;        // 未命中、需要查目录的次数
+    uint64_t invalidations = 0; // 因目录修改而失效的条目数
+};
+
+// 空间使用情况（df）
+struct SpaceInfo
+{
+    uint32_t total_blocks = 0;     // 总块数
+    uint32_t data_blocks = 0;      // 数据区块数
+    uint32_t free_blocks = 0;      // 空闲块数
+    uint32_t largest_free_run = 0; // 最长的连续空闲段（块数），空闲段不跨分配组
+    uint32_t groups = 0;           // 分配组数
 };
 
 // 系统内容结构体
@@ -103,4 +374,35 @@ struct SystemContext
     User currentUser;        // 当前用户
 };
 
-#endif
\ No newline at end of file
+// 当前线程的输出目标：交互模式下是标准输出和标准错误，
+// 服务模式下工作线程在执行命令期间把它们指向当前会话的连接，cat 的流式输出也写到 SessionFd
+inline thread_local std::ostream *sessionOut = nullptr;
+inline thread_local std::ostream *sessionErr = nullptr;
+inline thread_local int sessionFd = 1;
+
+inline std::ostream &SessionOut()
+{
+    return (sessionOut != nullptr) ? *sessionOut : std::cout;
+}
+
+inline std::ostream &SessionErr()
+{
+    return (sessionErr != nullptr) ? *sessionErr : std::cerr;
+}
+
+inline int SessionFd()
+{
+    return sessionFd;
+}
+
+// 绑定当前线程的输出目标，传入空指针和 1 恢复为标准输出
+inline void BindSession(std::ostream *out, std::ostream *err, int fd)
+{
+    sessionOut = out;
+    sessionErr = err;
+    sessionFd = fd;
+}
+
+} // namespace FS_NAMESPACE
+
+#endif
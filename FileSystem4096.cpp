@@ -0,0 +1,14 @@
+// 以 4096 字节块把全部模块再编译一遍，代码落在 fs4096 命名空间里；512 字节块的一份由各模块自己的编译单元生成
+// 块大小相关的常量、结构体布局和缓冲区都随 FS_BLOCK_SIZE 在编译期确定，两份代码互不影响
+#define FS_BLOCK_SIZE 4096
+#include "BlockDevice.cpp"
+#include "FreeSpaceTree.cpp"
+#include "DiskManager.cpp"
+#include "BlockMapper.cpp"
+#include "DirectoryManager.cpp"
+#include "LockManager.cpp"
+#include "FileManager.cpp"
+#include "UserManager.cpp"
+#include "Shell.cpp"
+#include "Server.cpp"
+#include "Launcher.cpp"
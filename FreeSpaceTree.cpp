@@ -0,0 +1,153 @@
+#include "FreeSpaceTree.h"
+
+namespace FS_NAMESPACE
+{
+
+// 根据块位图中 [firstBlock, endBlock) 这一段构建摘要树
+// bitmap 为磁盘上的块位图（字节内高位在前），范围之外的位置一律视为已占用
+void FreeSpaceTree::Build(const uint8_t *bitmap, uint32_t firstBlock, uint32_t endBlock)
+{
+    base = firstBlock;
+    uint32_t needed = (endBlock - firstBlock + 63) / 64;
+    leafCount = 1;
+    while (leafCount < needed)
+        leafCount <<= 1;
+    leaves.assign(leafCount, ~0ULL);
+    nodes.assign(leafCount * 2, Node());
+    // 1. 把位图转换成叶子字（块号小的在低位，便于用 ctz/clz 计算两端空闲段）
+    for (uint32_t block = firstBlock; block < endBlock; ++block)
+        if (!(bitmap[block / 8] & (0x80 >> (block % 8))))
+            leaves[(block - base) / 64] &= ~(1ULL << ((block - base) % 64));
+    // 2. 自底向上计算摘要
+    for (uint32_t leaf = 0; leaf < leafCount; ++leaf)
+        BuildLeaf(leaf);
+    for (uint32_t node = leafCount - 1; node >= 1; --node)
+        Pull(node);
+}
+
+// 由叶子字计算叶子结点的摘要
+void FreeSpaceTree::BuildLeaf(uint32_t leaf)
+{
+    uint64_t used = leaves[leaf];
+    Node &n = nodes[leafCount + leaf];
+    n.len = 64;
+    n.free = 64 - __builtin_popcountll(used);
+    n.prefix = (used == 0) ? 64 : __builtin_ctzll(used);
+    n.suffix = (used == 0) ? 64 : __builtin_clzll(used);
+    // 最长连续 0 段：对取反后的字反复与自身左移一位相与，能坚持的轮数即最长连续 1 段的长度
+    uint64_t freeBits = ~used;
+    uint32_t best = 0;
+    while (freeBits != 0)
+    {
+        freeBits &= freeBits << 1;
+        ++best;
+    }
+    n.best = best;
+}
+
+// 由左右孩子合并出结点的摘要
+void FreeSpaceTree::Pull(uint32_t node)
+{
+    const Node &l = nodes[node * 2];
+    const Node &r = nodes[node * 2 + 1];
+    Node &n = nodes[node];
+    n.len = l.len + r.len;
+    n.free = l.free + r.free;
+    n.prefix = (l.prefix == l.len) ? l.len + r.prefix : l.prefix;
+    n.suffix = (r.suffix == r.len) ? r.len + l.suffix : r.suffix;
+    n.best = std::max(std::max(l.best, r.best), l.suffix + r.prefix);
+}
+
+// 更新单个块的占用状态
+void FreeSpaceTree::Update(uint32_t block, bool used)
+{
+    UpdateRange(block, 1, used);
+}
+
+// 更新一段连续块的占用状态，只重算受影响的叶子及其祖先
+void FreeSpaceTree::UpdateRange(uint32_t start, uint32_t count, bool used)
+{
+    if (count == 0 || start < base || (start - base + count + 63) / 64 > leafCount)
+        return;
+    start -= base;
+    uint32_t firstLeaf = start / 64, lastLeaf = (start + count - 1) / 64;
+    for (uint32_t block = start; block < start + count; ++block)
+    {
+        if (used)
+            leaves[block / 64] |= (1ULL << (block % 64));
+        else
+            leaves[block / 64] &= ~(1ULL << (block % 64));
+    }
+    for (uint32_t leaf = firstLeaf; leaf <= lastLeaf; ++leaf)
+        BuildLeaf(leaf);
+    // 逐层向上，只重算覆盖 [firstLeaf, lastLeaf] 的结点
+    uint32_t lo = (leafCount + firstLeaf) / 2, hi = (leafCount + lastLeaf) / 2;
+    while (lo >= 1)
+    {
+        for (uint32_t node = lo; node <= hi; ++node)
+            Pull(node);
+        lo /= 2;
+        hi /= 2;
+    }
+}
+
+// 在以 node 为根、起始块号为 lo 的子树中，查找起点不小于 from 的第一个长度为 count 的空闲段
+// carry 为紧挨在 lo 之前（且不小于 from）的连续空闲块数，查找过程中向右传递
+int64_t FreeSpaceTree::Search(uint32_t node, uint32_t lo, uint32_t from, uint32_t count, uint32_t &carry)
+{
+    const Node &n = nodes[node];
+    if (lo + n.len <= from)
+        return -1;
+    if (lo >= from)
+    {
+        // 整个结点都在查找范围内：利用摘要判断，无需深入
+        if (carry + n.prefix >= count)
+            return (int64_t)lo - carry;
+        if (n.best < count)
+        {
+            carry = (n.prefix == n.len) ? carry + n.len : n.suffix;
+            return -1;
+        }
+    }
+    if (node >= leafCount)
+    {
+        // 叶子：逐位检查
+        uint64_t used = leaves[node - leafCount];
+        for (uint32_t k = (lo >= from) ? 0 : from - lo; k < 64; ++k)
+        {
+            if (used & (1ULL << k))
+                carry = 0;
+            else if (++carry >= count)
+                return (int64_t)lo + k + 1 - count;
+        }
+        return -1;
+    }
+    int64_t found = Search(node * 2, lo, from, count, carry);
+    if (found >= 0)
+        return found;
+    return Search(node * 2 + 1, lo + nodes[node * 2].len, from, count, carry);
+}
+
+// 查找起点不小于 from 的第一个长度为 count 的空闲段，返回起始块号，找不到返回 -1
+int64_t FreeSpaceTree::FindRun(uint32_t count, uint32_t from)
+{
+    if (leafCount == 0 || count == 0 || nodes[1].best < count)
+        return -1;
+    uint32_t carry = 0;
+    int64_t found = Search(1, 0, (from > base) ? from - base : 0, count, carry);
+    return (found < 0) ? -1 : found + base;
+}
+
+// 空闲块总数
+uint32_t FreeSpaceTree::FreeCount()
+{
+    return leafCount == 0 ? 0 : nodes[1].free;
+}
+
+// 最长的连续空闲段
+uint32_t FreeSpaceTree::LargestRun()
+{
+    return leafCount == 0 ? 0 : nodes[1].best;
+}
+
+} // namespace FS_NAMESPACE
@@ -0,0 +1,44 @@
+#ifndef FREE_SPACE_TREE_H
+#define FREE_SPACE_TREE_H
+
+#include "FileSystem.h"
+
+namespace FS_NAMESPACE
+{
+
+// 空闲空间摘要树：以 64 个块为一个叶子的线段树，覆盖块号 [base, base + 叶子数 * 64)
+// 每个结点记录子树内的空闲块数、最长空闲段以及左右两端的空闲段长度，
+// 用于在 O(log n) 时间内回答“第一个空闲块”、“某位置附近长度为 N 的空闲段”和 df 类查询
+class FreeSpaceTree
+{
+private:
+    struct Node
+    {
+        uint32_t len;    // 结点覆盖的块数
+        uint32_t free;   // 空闲块数
+        uint32_t prefix; // 从左端开始的连续空闲块数
+        uint32_t suffix; // 到右端为止的连续空闲块数
+        uint32_t best;   // 最长的连续空闲段
+    };
+
+    std::vector<uint64_t> leaves; // 叶子位图：第 k 位为 1 表示该叶子内第 k 个块已占用
+    std::vector<Node> nodes;      // 堆式存储，nodes[1] 为根，叶子从 leafCount 开始
+    uint32_t leafCount = 0;       // 叶子数（2 的幂）
+    uint32_t base = 0;            // 第一个叶子的第一位对应的块号
+
+    void BuildLeaf(uint32_t leaf);
+    void Pull(uint32_t node);
+    int64_t Search(uint32_t node, uint32_t lo, uint32_t from, uint32_t count, uint32_t &carry);
+
+public:
+    void Build(const uint8_t *bitmap, uint32_t firstBlock, uint32_t endBlock);
+    void Update(uint32_t block, bool used);
+    void UpdateRange(uint32_t start, uint32_t count, bool used);
+    int64_t FindRun(uint32_t count, uint32_t from);
+    uint32_t FreeCount();
+    uint32_t LargestRun();
+};
+
+} // namespace FS_NAMESPACE
+
+#endif
@@ -0,0 +1,131 @@
+#include "Launcher.h"
+
+namespace FS_NAMESPACE
+{
+
+// 以当前编译的块大小运行文件系统：解析启动参数，挂载或初始化镜像，然后进入 Shell 或服务方式
+int RunFileSystem(int argc, char *argv[])
+{
+    // 解析启动参数：--backend=stream|posix|mmap|uring 选择块设备后端
+    // --blocks=N、--inodes=N 只在首次初始化镜像时生效，决定磁盘的总块数和 Inode 数（--block-size 已由 main 处理）
+    // --durability=always|periodic|manual 选择持久化策略，--flush-interval=N 指定定期写回的间隔（毫秒）
+    // --serve[=套接字] 以服务方式运行，--workers=N 指定工作线程数；--connect[=套接字] 作为客户端连接到服务
+    DiskBackend backend = DEFAULT_BACKEND;
+    Geometry geometry;
+    bool serve = false, connectMode = false;
+    std::string socketPath = SERVER_SOCKET_PATH;
+    int workerCount = SERVER_WORKERS;
+    DurabilityPolicy durability = DURABILITY_ALWAYS;
+    uint32_t flushInterval = FLUSH_INTERVAL_MS;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 13, "--block-size=") == 0)
+            continue;
+        else if (arg.compare(0, 9, "--blocks=") == 0)
+            geometry.total_blocks = (uint32_t)strtoul(arg.c_str() + 9, nullptr, 10);
+        else if (arg.compare(0, 9, "--inodes=") == 0)
+            geometry.inode_count = (uint32_t)strtoul(arg.c_str() + 9, nullptr, 10);
+        else if (arg == "--backend=stream")
+            backend = BACKEND_STREAM;
+        else if (arg == "--backend=posix")
+            backend = BACKEND_POSIX;
+        else if (arg == "--backend=mmap")
+            backend = BACKEND_MMAP;
+        else if (arg == "--backend=uring")
+            backend = BACKEND_URING;
+        else if (arg == "--durability=always")
+            durability = DURABILITY_ALWAYS;
+        else if (arg == "--durability=periodic")
+            durability = DURABILITY_PERIODIC;
+        else if (arg == "--durability=manual")
+            durability = DURABILITY_MANUAL;
+        else if (arg.compare(0, 17, "--flush-interval=") == 0 && atoi(arg.c_str() + 17) > 0)
+            flushInterval = (uint32_t)atoi(arg.c_str() + 17);
+#ifndef _WIN32
+        else if (arg == "--serve" || arg.compare(0, 8, "--serve=") == 0)
+        {
+            serve = true;
+            if (arg.size() > 8)
+                socketPath = arg.substr(8);
+        }
+        else if (arg == "--connect" || arg.compare(0, 10, "--connect=") == 0)
+        {
+            connectMode = true;
+            if (arg.size() > 10)
+                socketPath = arg.substr(10);
+        }
+        else if (arg.compare(0, 10, "--workers=") == 0 && atoi(arg.c_str() + 10) > 0)
+            workerCount = atoi(arg.c_str() + 10);
+#endif
+        else
+        {
+            std::cerr << "用法: " << argv[0] << " [--backend=stream|posix|mmap|uring] [--block-size=512|4096] [--blocks=N] [--inodes=N]"
+                      << " [--durability=always|periodic|manual] [--flush-interval=N]"
+                      << " [--serve[=套接字] [--workers=N] | --connect[=套接字]]" << std::endl;
+            return 1;
+        }
+    }
+#ifndef _WIN32
+    // 客户端不打开镜像，只转发输入输出
+    if (connectMode)
+        return Server::RunClient(socketPath);
+#endif
+
+    SystemContext ctx;
+    DiskManager dm(VDISK_PATH, backend);
+    dm.SetDurability(durability, flushInterval);
+    UserManager um;
+    DirectoryManager dirm(&dm);
+    LockManager lm;
+    FileManager fm(&dm, &dirm, &ctx, &lm);
+    Shell shell;
+
+    // 读入用户列表
+    um.LoadUsers(ctx);
+    ctx.currentUser.userId = 0;
+    ctx.currentUser.groupId = GID_ROOT;
+    // 初始化系统
+    if (!dm.FileExists(VDISK_PATH))
+    {
+        std::cout << "检测到镜像不存在，正在进行首次初始化..." << std::endl;
+        if (!dm.InitializeDisk(VDISK_PATH, geometry))
+            return 1;
+        dirm.InitializeRoot();
+        lm.LockSuperBlock(VDISK_PATH);
+    }
+    else
+    {
+        // 同一时刻只有一个进程写镜像：超级块上的独占锁被其他进程持有时以只读方式挂载
+        if (!lm.LockSuperBlock(VDISK_PATH))
+        {
+            std::cout << "提示：镜像正由其他进程修改，本进程以只读方式挂载" << std::endl;
+            dm.SetReadOnly(true);
+        }
+        if (!dm.Mount())
+            return 1;
+    }
+    // 在镜像上加字节范围锁，与共用同一镜像的其他进程协调文件访问
+    lm.AttachImage(VDISK_PATH, dm.GetInodeStart());
+#ifndef _WIN32
+    // 服务方式：多个客户端会话共用这一份磁盘、缓存和锁表，退出时统一卸载
+    if (serve)
+    {
+        {
+            Server server(dm, um, dirm, lm, ctx);
+            if (!server.Start(socketPath, workerCount))
+                return 1;
+            server.Run();
+        }
+        dm.UnMount();
+        um.SaveUsersToFile(ctx);
+        return 0;
+    }
+#endif
+    // 启动 Shell
+    shell.Run(dm, um, dirm, fm, lm, ctx);
+
+    return 0;
+}
+
+} // namespace FS_NAMESPACE
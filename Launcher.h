@@ -0,0 +1,20 @@
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include "DiskManager.h"
+#include "UserManager.h"
+#include "DirectoryManager.h"
+#include "FileManager.h"
+#include "Shell.h"
+#include "FileSystem.h"
+#include "LockManager.h"
+#include "Server.h"
+
+namespace FS_NAMESPACE
+{
+
+int RunFileSystem(int argc, char *argv[]);
+
+} // namespace FS_NAMESPACE
+
+#endif
@@ -1,45 +1,210 @@
 #include "LockManager.h"
 
-LockManager::LockManager(DiskManager *dm)
+namespace FS_NAMESPACE
 {
-    this->disk = dm;
+
+// 按 Inode 编号选择分片
+LockManager::Shard &LockManager::ShardOf(uint32_t inodeId)
+{
+    return shards[inodeId % LOCK_SHARDS];
 }
 
-// 请求访问权限
-bool LockManager::RequestAccess(uint32_t inodeId, bool isWrite)
+// 判断当前状态下能否授予访问权：写需要独占；读要求没有写者，也没有正在等待的写者
+bool LockManager::CanGrant(const FileAccessStatus &status, bool isWrite)
 {
-    Inode node;
-    disk->ReadInode(inodeId, node); // 1. 从磁盘拿最新的状态
     if (isWrite)
+        return !status.is_writing && status.reader_count == 0;
+    return !status.is_writing && status.writers_waiting == 0;
+}
+
+LockManager::~LockManager()
+{
+#ifndef _WIN32
+    // 关闭描述符即释放其上的全部字节范围锁
+    if (imageFd != -1)
+        close(imageFd);
+#endif
+}
+
+// 打开镜像文件专用于跨进程加锁，已经打开时直接返回
+// 使用 OFD 锁而不是传统的 POSIX 记录锁：后者在进程关闭同一文件的任意描述符时就会全部丢失
+bool LockManager::OpenImage(const std::string &path)
+{
+#if defined(F_OFD_SETLK)
+    if (imageFd != -1)
+        return true;
+    imageFd = open(path.c_str(), O_RDWR);
+    if (imageFd == -1)
     {
-        if (node.is_writing != 0 || node.reader_count > 0)
-            return false;
-        node.is_writing = 1;
+        std::cerr << "警告：无法打开镜像文件加锁，只在本进程内加锁: " << strerror(errno) << std::endl;
+        return false;
     }
-    else
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+// 在超级块所在的字节上加独占锁，取得后本进程是唯一修改镜像的进程，直到进程退出
+// 镜像由其他进程持有时返回 false，调用者应以只读方式挂载；平台不支持 OFD 锁或打不开镜像时无法协调，按可写处理
+bool LockManager::LockSuperBlock(const std::string &path)
+{
+#if defined(F_OFD_SETLK)
+    if (!OpenImage(path))
+        return true;
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = 0;
+    fl.l_len = sizeof(SuperBlock);
+    return fcntl(imageFd, F_OFD_SETLK, &fl) != -1;
+#else
+    (void)path;
+    return true;
+#endif
+}
+
+// 在镜像上为文件访问权加字节范围锁，inodeStart 是 Inode 表的起始块号
+bool LockManager::AttachImage(const std::string &path, uint32_t inodeStart)
+{
+#if defined(F_OFD_SETLK)
+    if (!OpenImage(path))
+        return false;
+    inodeTableByte = (uint64_t)inodeStart * BLOCK_SIZE;
+    return true;
+#else
+    (void)path;
+    (void)inodeStart;
+    std::cerr << "警告：当前平台不支持 OFD 字节范围锁，只在本进程内加锁" << std::endl;
+    return false;
+#endif
+}
+
+// 让本进程在镜像上持有与请求相符的字节范围锁：已经持有足够的锁时什么也不做
+// 只尝试一次，不阻塞；被其他进程占用时返回 false
+bool LockManager::LockImage(uint32_t inodeId, FileAccessStatus &status, bool isWrite)
+{
+#if defined(F_OFD_SETLK)
+    if (imageFd == -1)
+        return true;
+    int wanted = isWrite ? 2 : 1;
+    if (status.image_lock >= wanted)
+        return true;
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = isWrite ? F_WRLCK : F_RDLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = inodeTableByte + (uint64_t)inodeId * sizeof(Inode);
+    fl.l_len = sizeof(Inode);
+    if (fcntl(imageFd, F_OFD_SETLK, &fl) == -1)
+        return false;
+    status.image_lock = wanted;
+#else
+    (void)inodeId;
+    (void)status;
+    (void)isWrite;
+#endif
+    return true;
+}
+
+// 释放本进程在镜像上持有的字节范围锁
+void LockManager::UnlockImage(uint32_t inodeId, FileAccessStatus &status)
+{
+#if defined(F_OFD_SETLK)
+    if (imageFd == -1 || status.image_lock == 0)
+        return;
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = F_UNLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = inodeTableByte + (uint64_t)inodeId * sizeof(Inode);
+    fl.l_len = sizeof(Inode);
+    fcntl(imageFd, F_OFD_SETLK, &fl);
+#else
+    (void)inodeId;
+#endif
+    status.image_lock = 0;
+}
+
+// 请求访问权限：timeoutMs 为 LOCK_TRY 时不等待，为 LOCK_WAIT 时一直等待，为正数时最多等待这么多毫秒
+// 进程内的锁表和镜像上的字节范围锁都满足时才授予；其他进程占用时每隔 LOCK_POLL_MS 重试一次
+bool LockManager::RequestAccess(uint32_t inodeId, bool isWrite, int timeoutMs)
+{
+    Shard &shard = ShardOf(inodeId);
+    std::unique_lock<std::mutex> guard(shard.mutex);
+    FileAccessStatus &status = shard.table[inodeId];
+    auto ready = [&]() { return CanGrant(status, isWrite) && LockImage(inodeId, status, isWrite); };
+    // 1. 能直接授予时立即返回
+    if (!ready())
     {
-        if (node.is_writing != 0)
+        if (timeoutMs == LOCK_TRY)
+        {
+            if (!status.is_writing && status.reader_count == 0 && status.waiting == 0)
+                shard.table.erase(inodeId);
+            return false;
+        }
+        // 2. 登记为等待者后在条件变量上等待，被唤醒或到达轮询间隔时重新判断
+        status.waiting++;
+        if (isWrite)
+            status.writers_waiting++;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        bool granted = false;
+        while (!(granted = ready()))
+        {
+            auto wake = std::chrono::steady_clock::now() + std::chrono::milliseconds(LOCK_POLL_MS);
+            if (timeoutMs > 0)
+            {
+                if (std::chrono::steady_clock::now() >= deadline)
+                    break;
+                wake = std::min(wake, deadline);
+            }
+            shard.cond.wait_until(guard, wake);
+        }
+        status.waiting--;
+        if (isWrite)
+            status.writers_waiting--;
+        if (!granted)
+        {
+            // 放弃等待的写者可能正挡着读者，唤醒它们重新判断
+            if (isWrite)
+                shard.cond.notify_all();
+            if (!status.is_writing && status.reader_count == 0 && status.waiting == 0)
+                shard.table.erase(inodeId);
             return false;
-        node.reader_count++;
+        }
     }
-    disk->WriteInode(inodeId, node); // 2. 立即同步回磁盘，实现进程间可见
+    // 3. 记录访问状态
+    if (isWrite)
+        status.is_writing = true;
+    else
+        status.reader_count++;
     return true;
 }
 
-// 释放访问权限
+// 释放访问权限，并唤醒同一分片上的等待者
 void LockManager::ReleaseAccess(uint32_t inodeId, bool isWrite)
 {
-    // 1. 从磁盘读取该 Inode
-    Inode node;
-    disk->ReadInode(inodeId, node);
-    // 2. 更新状态位
+    Shard &shard = ShardOf(inodeId);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto it = shard.table.find(inodeId);
+    if (it == shard.table.end())
+        return;
+    FileAccessStatus &status = it->second;
+    // 1. 更新状态位
     if (isWrite)
-        node.is_writing = 0; // 释放写锁
-    else
-    {
-        if (node.reader_count > 0)
-            node.reader_count--; // 读者减一
-    }
-    // 3. 写回磁盘并同步
-    disk->WriteInode(inodeId, node);
-}
\ No newline at end of file
+        status.is_writing = false; // 释放写锁
+    else if (status.reader_count > 0)
+        status.reader_count--; // 读者减一
+    // 2. 本进程不再有人持有时释放镜像上的锁，让其他进程可以获得
+    if (!status.is_writing && status.reader_count == 0)
+        UnlockImage(inodeId, status);
+    // 3. 有人等待时唤醒；完全空闲的项直接删除，锁表大小只与正在访问的文件数有关
+    if (status.waiting > 0)
+        shard.cond.notify_all();
+    else if (!status.is_writing && status.reader_count == 0)
+        shard.table.erase(it);
+}
+
+} // namespace FS_NAMESPACE
@@ -2,17 +2,66 @@
 #define LOCK_MANAGER_H
 
 #include "FileSystem.h"
-#include "DiskManager.h"
 
+namespace FS_NAMESPACE
+{
+
+// 等待方式：RequestAccess 的 timeoutMs 参数取这两个值之一，或者取正数表示最多等待的毫秒数
+const int LOCK_TRY = 0;   // 不等待，拿不到立即返回 false
+const int LOCK_WAIT = -1; // 一直等到拿到为止
+
+// 文件读写锁表：每个 Inode 一个读写锁，只保存在内存中，不产生任何磁盘读写
+// 按 Inode 编号分成 LOCK_SHARDS 片，各片有独立的互斥锁和条件变量，不同文件的加锁互不阻塞
+// AttachImage 之后还会在镜像文件中该 Inode 所在的 128 字节上加 fcntl OFD 字节范围锁，协调共用同一镜像的多个进程：
+// 进程内的线程由锁表仲裁，进程内只要有人持有就在镜像上保持相应的共享/独占锁，进程退出时由内核自动释放
+// 修改镜像的进程还要在超级块上持有独占锁（LockSuperBlock），同一时刻只有一个进程写镜像，其余进程只读挂载
 class LockManager
 {
 private:
-    DiskManager *disk;
+    struct Shard
+    {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::unordered_map<uint32_t, FileAccessStatus> table; // Inode 编号 -> 访问状态，空闲时删除
+    };
+    Shard shards[LOCK_SHARDS];
+    int imageFd = -1;         // 专门用于字节范围锁的镜像文件描述符，-1 表示只做进程内加锁
+
+    bool OpenImage(const std::string &path);
+    uint64_t inodeTableByte = 0; // Inode 表在镜像文件中的字节偏移
+
+    Shard &ShardOf(uint32_t inodeId);
+    static bool CanGrant(const FileAccessStatus &status, bool isWrite);
+    bool LockImage(uint32_t inodeId, FileAccessStatus &status, bool isWrite);
+    void UnlockImage(uint32_t inodeId, FileAccessStatus &status);
 
 public:
-    LockManager(DiskManager *dm);
-    bool RequestAccess(uint32_t inodeId, bool isWrite);
+    LockManager() = default;
+    ~LockManager();
+    LockManager(const LockManager &) = delete;
+    LockManager &operator=(const LockManager &) = delete;
+    bool LockSuperBlock(const std::string &path);
+    bool AttachImage(const std::string &path, uint32_t inodeStart);
+    bool RequestAccess(uint32_t inodeId, bool isWrite, int timeoutMs = LOCK_TRY);
     void ReleaseAccess(uint32_t inodeId, bool isWrite);
 };
 
-#endif
\ No newline at end of file
+// 访问权守卫：构造时一直等到取得访问权，离开作用域时释放；用于目录这类只在一次操作内持有的访问权
+// 需要同时开启事务时先取得访问权，事务句柄内不能等待访问权
+class AccessGuard
+{
+private:
+    LockManager *locks;
+    uint32_t inodeId;
+    bool isWrite;
+
+public:
+    AccessGuard(LockManager *lm, uint32_t id, bool write) : locks(lm), inodeId(id), isWrite(write) { locks->RequestAccess(inodeId, isWrite, LOCK_WAIT); }
+    ~AccessGuard() { locks->ReleaseAccess(inodeId, isWrite); }
+    AccessGuard(const AccessGuard &) = delete;
+    AccessGuard &operator=(const AccessGuard &) = delete;
+};
+
+} // namespace FS_NAMESPACE
+
+#endif
@@ -0,0 +1,395 @@
+#include "Server.h"
+
+namespace FS_NAMESPACE
+{
+
+#ifndef _WIN32
+int Server::stopFd = -1;
+
+Server::Server(DiskManager &dm, UserManager &um, DirectoryManager &dirm, LockManager &lm, SystemContext &shared)
+    : dm(dm), um(um), dirm(dirm), lm(lm), shared(shared)
+{
+}
+
+Server::~Server()
+{
+    if (listenFd != -1)
+    {
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+    for (int fd : wakePipe)
+        if (fd != -1)
+            close(fd);
+    stopFd = -1;
+}
+
+// 启动服务：创建监听套接字和唤醒管道，注册退出信号，启动工作线程
+bool Server::Start(const std::string &path, int workerCount)
+{
+    // 1. 检查套接字路径：已有服务在监听时拒绝启动，上次异常退出留下的套接字文件直接清理
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "错误：套接字路径过长: " << path << std::endl;
+        return false;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe != -1 && connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0)
+    {
+        close(probe);
+        std::cerr << "错误：已有服务在 " << path << " 上运行！" << std::endl;
+        return false;
+    }
+    if (probe != -1)
+        close(probe);
+    unlink(path.c_str());
+    // 2. 创建监听套接字
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd == -1 || bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1 ||
+        listen(listenFd, SOMAXCONN) == -1)
+    {
+        std::cerr << "错误：无法监听 " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    socketPath = path;
+    // 3. 唤醒管道和信号：SIGINT/SIGTERM 通过管道通知主线程退出，客户端断开时忽略 SIGPIPE
+    if (pipe(wakePipe) == -1)
+        return false;
+    stopFd = wakePipe[1];
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    signal(SIGPIPE, SIG_IGN);
+    // 4. 启动工作线程
+    for (int i = 0; i < workerCount; ++i)
+        workers.emplace_back(&Server::WorkerLoop, this);
+    std::cout << "服务已启动: " << path << "（" << workerCount << " 个工作线程）" << std::endl;
+    return true;
+}
+
+// 主循环：监听新连接和空闲会话的输入，把完整的命令行派发给工作线程，直到收到退出信号
+void Server::Run()
+{
+    bool running = true;
+    while (running)
+    {
+        // 1. 监听新连接、唤醒管道以及所有空闲会话的输入；有请求在执行的会话暂不读取
+        std::vector<pollfd> fds;
+        fds.push_back({listenFd, POLLIN, 0});
+        fds.push_back({wakePipe[0], POLLIN, 0});
+        for (auto &item : sessions)
+            if (!item.second->busy && !item.second->eof)
+                fds.push_back({item.first, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        // 2. 取走唤醒字节：'q' 表示退出，其余表示有请求执行完毕
+        if (fds[1].revents & POLLIN)
+        {
+            char drain[64];
+            ssize_t n = read(wakePipe[0], drain, sizeof(drain));
+            for (ssize_t i = 0; i < n; ++i)
+                if (drain[i] == 'q')
+                    running = false;
+        }
+        // 3. 接受新连接，读取各会话的输入
+        if (fds[0].revents & POLLIN)
+            Accept();
+        for (size_t i = 2; i < fds.size(); ++i)
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                auto it = sessions.find(fds[i].fd);
+                if (it != sessions.end())
+                    ReadInput(*it->second);
+            }
+        // 4. 空闲的会话：已结束的回收，有完整命令行的派发下一条
+        std::vector<int> finished;
+        for (auto &item : sessions)
+        {
+            Session &session = *item.second;
+            if (session.busy)
+                continue;
+            if (session.closed || (session.eof && session.input.find('\n') == std::string::npos))
+                finished.push_back(item.first);
+            else
+                Dispatch(session);
+        }
+        for (int fd : finished)
+            CloseSession(fd);
+    }
+    // 5. 停止工作线程（正在执行的请求会先完成），再关闭所有会话
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        stopping = true;
+    }
+    queueCond.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+    workers.clear();
+    while (!sessions.empty())
+        CloseSession(sessions.begin()->first);
+    std::cout << "服务已停止" << std::endl;
+}
+
+// 接受一个新连接，建立会话，并让工作线程发送欢迎信息和提示符
+void Server::Accept()
+{
+    int fd = accept(listenFd, nullptr, nullptr);
+    if (fd == -1)
+        return;
+    std::unique_ptr<Session> session(new Session());
+    session->fd = fd;
+    session->ctx.currentUser.userId = 0;
+    session->ctx.currentUser.groupId = GID_ROOT;
+    session->fm.reset(new FileManager(&dm, &dirm, &session->ctx, &lm));
+    session->busy = true;
+    Request request;
+    request.session = session.get();
+    request.greeting = true;
+    sessions[fd] = std::move(session);
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        queue.push_back(request);
+    }
+    queueCond.notify_one();
+}
+
+// 读取会话的输入，追加到待执行的缓冲中
+void Server::ReadInput(Session &session)
+{
+    char buffer[4096];
+    ssize_t n = recv(session.fd, buffer, sizeof(buffer), 0);
+    if (n < 0 && errno == EINTR)
+        return;
+    if (n <= 0)
+    {
+        session.eof = true;
+        return;
+    }
+    session.input.append(buffer, n);
+    // 一直收不到换行的超长输入直接丢弃并结束会话
+    if (session.input.size() > SERVER_MAX_LINE && session.input.find('\n') == std::string::npos)
+    {
+        session.input.clear();
+        session.eof = true;
+    }
+}
+
+// 取出一整行命令交给工作线程
+void Server::Dispatch(Session &session)
+{
+    size_t pos = session.input.find('\n');
+    if (pos == std::string::npos)
+        return;
+    Request request;
+    request.session = &session;
+    request.line = session.input.substr(0, pos);
+    if (!request.line.empty() && request.line.back() == '\r')
+        request.line.pop_back();
+    session.input.erase(0, pos + 1);
+    session.busy = true;
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        queue.push_back(request);
+    }
+    queueCond.notify_one();
+}
+
+// 回收会话：关闭它打开的文件（释放访问权），再关闭连接
+void Server::CloseSession(int fd)
+{
+    auto it = sessions.find(fd);
+    if (it == sessions.end())
+        return;
+    {
+        std::shared_lock<std::shared_mutex> guard(fsLock);
+        it->second->fm->CloseAll();
+        it->second->fm.reset();
+    }
+    close(fd);
+    sessions.erase(it);
+}
+
+// 工作线程：从队列取请求执行，完成后唤醒主线程继续派发该会话的下一条命令
+void Server::WorkerLoop()
+{
+    while (true)
+    {
+        Request request;
+        {
+            std::unique_lock<std::mutex> guard(queueMutex);
+            queueCond.wait(guard, [this]() { return stopping || !queue.empty(); });
+            if (stopping)
+                return;
+            request = queue.front();
+            queue.pop_front();
+        }
+        Execute(request);
+        request.session->busy = false;
+        char c = 'w';
+        ssize_t n = write(wakePipe[1], &c, 1);
+        (void)n;
+    }
+}
+
+// 执行一个请求：本线程的输出绑定到会话的连接；修改文件系统的命令和只读命令一样持有共享锁并发执行，
+// 同一文件或目录上的冲突由 LockManager 的访问权仲裁，只有修改用户列表的 su 持有独占锁；
+// 只读挂载时每条命令都要先重新读入镜像，所有命令独占执行
+void Server::Execute(const Request &request)
+{
+    Session &session = *request.session;
+    SocketBuf buffer(session.fd);
+    std::ostream out(&buffer);
+    BindSession(&out, &out, session.fd);
+    bool exclusive = !request.greeting && (dm.IsReadOnly() || shell.IsExclusive(request.line));
+    std::shared_lock<std::shared_mutex> readGuard(fsLock, std::defer_lock);
+    std::unique_lock<std::shared_mutex> writeGuard(fsLock, std::defer_lock);
+    if (exclusive)
+        writeGuard.lock();
+    else
+        readGuard.lock();
+    if (request.greeting)
+        out << "欢迎使用FS！ (输入'help'获取指令列表)" << std::endl;
+    else
+    {
+        // 用户列表所有会话共用：执行前取最新的，独占执行的命令执行后写回（su 可能新建用户）
+        session.ctx.uList = shared.uList;
+        bool keep = shell.ExecuteLine(request.line, dm, um, dirm, *session.fm, lm, session.ctx);
+        if (exclusive)
+            shared.uList = session.ctx.uList;
+        if (!keep)
+        {
+            // exit 只结束本会话，不卸载磁盘
+            session.fm->CloseAll();
+            out << "再见！" << std::endl;
+            session.closed = true;
+        }
+    }
+    if (!session.closed)
+        shell.PrintPrompt(session.ctx, *session.fm);
+    out.flush();
+    BindSession(nullptr, nullptr, 1);
+}
+
+// 信号处理：只向管道写一个字节，由主线程完成退出
+void Server::OnSignal(int sig)
+{
+    (void)sig;
+    if (stopFd != -1)
+    {
+        char c = 'q';
+        ssize_t n = write(stopFd, &c, 1);
+        (void)n;
+    }
+}
+
+// 写出全部数据，处理部分写入和信号中断
+bool Server::WriteAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+Server::SocketBuf::SocketBuf(int fd) : fd(fd)
+{
+    setp(buffer, buffer + sizeof(buffer));
+}
+
+Server::SocketBuf::~SocketBuf()
+{
+    sync();
+}
+
+// 缓冲区满：先发送已有内容，再放入新字符
+int Server::SocketBuf::overflow(int ch)
+{
+    if (sync() == -1)
+        return traits_type::eof();
+    if (ch != traits_type::eof())
+    {
+        *pptr() = (char)ch;
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+// 把缓冲区中的内容发送到连接上
+int Server::SocketBuf::sync()
+{
+    size_t len = pptr() - pbase();
+    setp(buffer, buffer + sizeof(buffer));
+    if (len > 0 && !WriteAll(fd, buffer, len))
+        return -1;
+    return 0;
+}
+
+// 客户端：连接到服务后把标准输入原样转发过去，把服务的输出原样写到标准输出
+int Server::RunClient(const std::string &path)
+{
+    // 1. 连接服务
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1)
+    {
+        std::cerr << "错误：无法连接到服务 " << path << ": " << strerror(errno) << std::endl;
+        if (fd != -1)
+            close(fd);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    // 2. 双向转发：标准输入结束后关闭写方向，继续接收剩余输出，直到服务关闭连接
+    bool inputOpen = true;
+    char buffer[4096];
+    while (true)
+    {
+        pollfd fds[2] = {{fd, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+        if (poll(fds, inputOpen ? 2 : 1, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n <= 0 || !WriteAll(STDOUT_FILENO, buffer, n))
+                break;
+        }
+        if (inputOpen && (fds[1].revents & (POLLIN | POLLHUP | POLLERR)))
+        {
+            ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+            if (n <= 0)
+            {
+                shutdown(fd, SHUT_WR);
+                inputOpen = false;
+            }
+            else if (!WriteAll(fd, buffer, n))
+                break;
+        }
+    }
+    close(fd);
+    return 0;
+}
+#endif
+
+} // namespace FS_NAMESPACE
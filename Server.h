@@ -0,0 +1,103 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "FileSystem.h"
+#include "DiskManager.h"
+#include "DirectoryManager.h"
+#include "FileManager.h"
+#include "UserManager.h"
+#include "LockManager.h"
+#include "Shell.h"
+
+namespace FS_NAMESPACE
+{
+
+#ifndef _WIN32
+// 文件系统服务：一个进程持有 DiskManager、各级缓存和锁表，通过 Unix 套接字同时为多个客户端会话服务
+// 主线程用 poll 监听新连接和各会话的输入，每收到一整行就作为一个请求交给工作线程池执行；
+// 同一会话的请求逐条按顺序执行，每个会话有自己的 SystemContext（当前用户）和 FileManager（当前目录、打开文件表）；
+// 不同会话的命令（包括写文件、建目录等修改）在工作线程中并发执行
+class Server
+{
+private:
+    // 一个客户端会话
+    struct Session
+    {
+        int fd = -1;                     // 连接
+        SystemContext ctx;               // 会话自己的当前用户
+        std::unique_ptr<FileManager> fm; // 会话自己的当前目录和打开文件表
+        std::string input;               // 已收到但还没执行的输入（只由主线程访问）
+        bool eof = false;                // 客户端已关闭写方向，执行完剩余的命令后结束
+        std::atomic<bool> busy{false};   // 是否有请求交给了工作线程
+        std::atomic<bool> closed{false}; // 会话已 exit，等待主线程回收
+    };
+
+    // 交给工作线程的请求
+    struct Request
+    {
+        Session *session = nullptr;
+        std::string line;
+        bool greeting = false; // 新连接的欢迎信息，而不是一条命令
+    };
+
+    // 输出流缓冲区：攒满或 flush 时直接写到连接上
+    class SocketBuf : public std::streambuf
+    {
+    private:
+        int fd;
+        char buffer[4096];
+
+    protected:
+        int overflow(int ch) override;
+        int sync() override;
+
+    public:
+        explicit SocketBuf(int fd);
+        ~SocketBuf();
+    };
+
+    DiskManager &dm;
+    UserManager &um;
+    DirectoryManager &dirm;
+    LockManager &lm;
+    SystemContext &shared; // 全局的用户列表，所有会话共用
+    Shell shell;
+
+    int listenFd = -1;
+    int wakePipe[2] = {-1, -1}; // 工作线程完成请求或收到退出信号时写入，唤醒主线程的 poll
+    std::string socketPath;
+    std::map<int, std::unique_ptr<Session>> sessions; // 连接描述符 -> 会话，只由主线程增删
+
+    std::mutex queueMutex;
+    std::condition_variable queueCond;
+    std::deque<Request> queue;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+    std::shared_mutex fsLock; // 会话共用状态的读写锁：命令共享执行，修改用户列表的 su 独占执行
+
+    static int stopFd; // 信号处理函数用来唤醒主线程的管道写端
+
+    void Accept();
+    void ReadInput(Session &session);
+    void Dispatch(Session &session);
+    void CloseSession(int fd);
+    void WorkerLoop();
+    void Execute(const Request &request);
+    static void OnSignal(int sig);
+    static bool WriteAll(int fd, const char *data, size_t len);
+
+public:
+    Server(DiskManager &dm, UserManager &um, DirectoryManager &dirm, LockManager &lm, SystemContext &shared);
+    ~Server();
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+
+    bool Start(const std::string &path, int workerCount);
+    void Run();
+    static int RunClient(const std::string &path);
+};
+#endif
+
+} // namespace FS_NAMESPACE
+
+#endif
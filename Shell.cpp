@@ -1,27 +1,75 @@
 #include "Shell.h"
 
+namespace FS_NAMESPACE
+{
+
 void Shell::Run(DiskManager &dm, UserManager &um, DirectoryManager &dirm, FileManager &fm, LockManager &lm, SystemContext &ctx)
 {
     std::string input;
-    std::cout << "欢迎使用FS！ (输入'help'获取指令列表)" << std::endl;
+    SessionOut() << "欢迎使用FS！ (输入'help'获取指令列表)" << std::endl;
     while (true)
     {
         PrintPrompt(ctx, fm);
         if (!std::getline(std::cin, input))
             break; // 处理 Ctrl+C 等异常退出
-        if (input.empty())
-            continue; // 忽略空输入
-        std::vector<std::string> args = ParseInput(input);
-        std::string cmd = args[0];
-        if (cmd == "exit" || cmd == "logout")
+        if (!ExecuteLine(input, dm, um, dirm, fm, lm, ctx))
         {
+            fm.CloseAll();
             dm.UnMount();
             um.SaveUsersToFile(ctx);
-            std::cout << "再见！" << std::endl;
+            SessionOut() << "再见！" << std::endl;
             break;
         }
+    }
+}
+
+// 执行一行命令，遇到 exit/logout 时返回 false，由调用者负责退出（交互模式卸载磁盘，服务模式只结束会话）
+bool Shell::ExecuteLine(const std::string &input, DiskManager &dm, UserManager &um, DirectoryManager &dirm, FileManager &fm, LockManager &lm, SystemContext &ctx)
+{
+    std::vector<std::string> args = ParseInput(input);
+    if (args.empty())
+        return true; // 忽略空输入
+    if (args[0] == "exit" || args[0] == "logout")
+        return false;
+    // 只读挂载：不执行修改镜像的命令；其余命令执行前先读入写入进程已经写回的内容
+    if (dm.IsReadOnly())
+    {
+        if (IsMutating(args))
+        {
+            SessionErr() << "错误：镜像正由其他进程修改，本进程只读，不能执行 " << args[0] << "！" << std::endl;
+            return true;
+        }
+        if (!dm.Refresh())
+            SessionErr() << "错误：重新读取镜像失败！" << std::endl;
+        dirm.ClearDentries();
+    }
+    // 参数转换失败（如 stoul 遇到非数字）只影响这一条命令，服务模式下不能让异常结束整个进程
+    try
+    {
         ExecuteCommand(args, dm, um, dirm, fm, lm, ctx);
     }
+    catch (const std::exception &)
+    {
+        SessionErr() << "错误：无效的参数！" << std::endl;
+    }
+    return true;
+}
+
+// 判断一行命令在服务模式下是否要独占执行：只有 su 会修改所有会话共用的用户列表
+// 文件和目录的修改由 LockManager 的访问权和事务保护，与其他会话的命令并发执行
+bool Shell::IsExclusive(const std::string &input)
+{
+    std::vector<std::string> args = ParseInput(input);
+    return !args.empty() && args[0] == "su";
+}
+
+// 判断命令是否会修改镜像：建立、删除、写入文件，以及以写方式打开文件
+bool Shell::IsMutating(const std::vector<std::string> &args)
+{
+    const std::string &cmd = args[0];
+    if (cmd == "mkdir" || cmd == "touch" || cmd == "rm" || cmd == "write" || cmd == "append" || cmd == "fwrite")
+        return true;
+    return cmd == "open" && args.size() >= 3 && (args[2] == "w" || args[2] == "a");
 }
 
 // 解析用户输入的命令行参数
@@ -38,15 +86,15 @@ std::vector<std::string> Shell::ParseInput(const std::string &input)
 // 实时输出 context 里的信息
 void Shell::PrintPrompt(SystemContext &ctx, FileManager &fm)
 {
-    std::cout << "[";
+    SessionOut() << "[";
     if (ctx.currentUser.groupId == GID_ROOT)
-        std::cout << "管理员";
+        SessionOut() << "管理员";
     else if (ctx.currentUser.groupId == GID_USERS)
-        std::cout << "用户" << ctx.currentUser.userId;
+        SessionOut() << "用户" << ctx.currentUser.userId;
     else if (ctx.currentUser.groupId == GID_GUEST)
-        std::cout << "访客" << ctx.currentUser.userId;
+        SessionOut() << "访客" << ctx.currentUser.userId;
     std::string path = fm.GetAbsolutePath();
-    std::cout << "@FS" << path << "]$ ";
+    SessionOut() << "@FS" << path << "]$ ";
 }
 
 // 执行命令
@@ -59,25 +107,29 @@ void Shell::ExecuteCommand(const std::vector<std::string> &args, DiskManager &dm
     {
         if (args.size() < 3)
         {
-            std::cout << "用法: su <userID> <groupID>" << std::endl;
+            SessionOut() << "用法: su <userID> <groupID>" << std::endl;
             return;
         }
         else
             um.SwitchUser(ctx, args);
     }
     else if (cmd == "ls")
+    {
+        // 列目录期间持有目录的读访问权，其他会话在这个目录下的增删等列完再进行
+        AccessGuard dirGuard(&lm, fm.GetCurrentInodeId(), false);
         ShowList(fm.GetCurrentInodeId(), dirm, &dm);
+    }
     else if (cmd == "cd")
     {
         if (args.size() < 2)
-            std::cout << "用法: cd <dirname>" << std::endl;
+            SessionOut() << "用法: cd <dirname>" << std::endl;
         else
             ExecuteCD(args[1], fm);
     }
     else if (cmd == "mkdir")
     {
         if (args.size() < 2)
-            std::cout << "用法: mkdir <dirname> [perm]" << std::endl;
+            SessionOut() << "用法: mkdir <dirname> [perm]" << std::endl;
         else if (args.size() == 2)
             fm.MakeDirectory(args[1]);
         else
@@ -86,7 +138,7 @@ void Shell::ExecuteCommand(const std::vector<std::string> &args, DiskManager &dm
     else if (cmd == "touch")
     {
         if (args.size() < 2)
-            std::cout << "用法: touch <filename> [perm]" << std::endl;
+            SessionOut() << "用法: touch <filename> [perm]" << std::endl;
         else if (args.size() == 2)
             fm.TouchFile(args[1]);
         else
@@ -95,21 +147,21 @@ void Shell::ExecuteCommand(const std::vector<std::string> &args, DiskManager &dm
     else if (cmd == "rm")
     {
         if (args.size() < 2)
-            std::cout << "用法: rm <filename>" << std::endl;
+            SessionOut() << "用法: rm <filename>" << std::endl;
         else
-            ExecuteRM(args[1], dirm, fm, &dm, lm, ctx);
+            ExecuteRM(args[1], fm, ctx);
     }
     else if (cmd == "cat")
     {
         if (args.size() < 2)
-            std::cout << "用法: cat <filename>" << std::endl;
+            SessionOut() << "用法: cat <filename>" << std::endl;
         else
-            ExecuteCat(args[1], dm, dirm, lm, fm, ctx);
+            ExecuteCat(args[1], fm);
     }
     else if (cmd == "write")
     {
         if (args.size() < 3)
-            std::cout << "用法: write <filename> <content>" << std::endl;
+            SessionOut() << "用法: write <filename> <content>" << std::endl;
         else
         {
             std::string full_content = "";
@@ -121,17 +173,115 @@ void Shell::ExecuteCommand(const std::vector<std::string> &args, DiskManager &dm
                     full_content += " ";
                 }
             }
-            ExecuteWrite(args[1], full_content, dm, dirm, lm, fm, ctx);
+            ExecuteWrite(args[1], full_content, false, fm);
+        }
+    }
+    else if (cmd == "append")
+    {
+        if (args.size() < 3)
+            SessionOut() << "用法: append <filename> <content>" << std::endl;
+        else
+        {
+            std::string line = "";
+            for (size_t i = 2; i < args.size(); ++i)
+            {
+                line += args[i];
+                if (i != args.size() - 1)
+                    line += " ";
+            }
+            ExecuteWrite(args[1], line + "\n", true, fm);
+        }
+    }
+    else if (cmd == "head" || cmd == "tail")
+    {
+        if (args.size() < 2)
+            SessionOut() << "用法: " << cmd << " <filename> [lines]" << std::endl;
+        else
+        {
+            uint32_t lines = (args.size() == 3) ? std::stoul(args[2]) : 10;
+            ExecuteHeadTail(args[1], lines, cmd == "tail", fm);
+        }
+    }
+    else if (cmd == "open")
+    {
+        if (args.size() < 2)
+            SessionOut() << "用法: open <filename> [r|w|a]" << std::endl;
+        else
+        {
+            std::string mode = (args.size() >= 3) ? args[2] : "r";
+            int flags = (mode == "w") ? OPEN_WRITE : (mode == "a") ? (OPEN_WRITE | OPEN_APPEND) : OPEN_READ;
+            int fd = fm.Open(args[1], flags);
+            if (fd >= 0)
+                SessionOut() << "文件描述符: " << fd << std::endl;
+        }
+    }
+    else if (cmd == "close")
+    {
+        if (args.size() < 2)
+            SessionOut() << "用法: close <fd>" << std::endl;
+        else
+            fm.Close(std::stoi(args[1]));
+    }
+    else if (cmd == "read")
+    {
+        if (args.size() < 2)
+            SessionOut() << "用法: read <fd> [bytes]" << std::endl;
+        else
+            ExecuteRead(std::stoi(args[1]), (args.size() >= 3) ? std::stoul(args[2]) : 0, fm);
+    }
+    else if (cmd == "fwrite")
+    {
+        if (args.size() < 3)
+            SessionOut() << "用法: fwrite <fd> <content>" << std::endl;
+        else
+        {
+            std::string content = "";
+            for (size_t i = 2; i < args.size(); ++i)
+            {
+                content += args[i];
+                if (i != args.size() - 1)
+                    content += " ";
+            }
+            fm.Write(std::stoi(args[1]), content.data(), (uint32_t)content.size());
+        }
+    }
+    else if (cmd == "seek")
+    {
+        if (args.size() < 3)
+            SessionOut() << "用法: seek <fd> <offset> [set|cur|end]" << std::endl;
+        else
+        {
+            std::string from = (args.size() >= 4) ? args[3] : "set";
+            int whence = (from == "cur") ? SEEK_CUR : (from == "end") ? SEEK_END : SEEK_SET;
+            int64_t pos = fm.Seek(std::stoi(args[1]), std::stoll(args[2]), whence);
+            if (pos >= 0)
+                SessionOut() << "当前位置: " << pos << std::endl;
         }
     }
+    else if (cmd == "sync")
+    {
+        if (!dm.Sync())
+            SessionErr() << "错误：同步磁盘失败！" << std::endl;
+    }
+    else if (cmd == "fsync")
+    {
+        if (args.size() < 2)
+            SessionOut() << "用法: fsync <fd>" << std::endl;
+        else
+            fm.Fsync(std::stoi(args[1]));
+    }
+    else if (cmd == "cachestat")
+        ShowCacheStats(dm, dirm);
+    else if (cmd == "df")
+        ShowDiskUsage(dm);
     else
-        std::cout << "无效指令: " << cmd << "！输入'help'获取指令列表" << std::endl;
+        SessionOut() << "无效指令: " << cmd << "！输入'help'获取指令列表" << std::endl;
 }
 
 // 显示指令列表
 void Shell::ShowHelp()
 {
-    std::cout << "支持的指令:\n"
+    SessionOut() << "支持的指令:\n"
               << "    ls                      列出目录内容\n"
               << "    cd    <目录名>          切换当前工作目录\n"
               << "    mkdir <名称> [权限]     创建目录\n"
@@ -139,41 +289,99 @@ void Shell::ShowHelp()
               << "    rm    <名称>            删除文件或目录\n"
               << "    cat   <名称>            显示文件内容\n"
               << "    write <名称> <内容>     向文件覆盖式写入信息\n"
+              << "    append <名称> <内容>    在文件末尾追加一行\n"
+              << "    head  <名称> [行数]     显示文件开头几行（默认 10 行）\n"
+              << "    tail  <名称> [行数]     显示文件末尾几行（默认 10 行）\n"
+              << "    open  <名称> [r|w|a]    打开文件，返回文件描述符（只读/读写/追加）\n"
+              << "    read  <fd> [字节数]     从当前位置读取（默认读到末尾）\n"
+              << "    fwrite <fd> <内容>      在当前位置写入\n"
+              << "    seek  <fd> <位置> [set|cur|end] 移动读写位置\n"
+              << "    close <fd>              关闭文件描述符\n"
+              << "    fsync <fd>              让文件已完成的写入持久\n"
+              << "    sync                    把所有修改写回磁盘\n"
               << "    su    <用户ID> <组ID>   切换用户（不存在则自动创建）\n"
+              << "    cachestat               显示缓存命中统计\n"
+              << "    df                      显示磁盘空间使用情况\n"
               << "    exit/logout             保存并退出系统" << std::endl;
 }
 
 // 显示目录内容的详细信息
 void Shell::ShowList(uint32_t currentInodeId, DirectoryManager &dir_mgr, DiskManager *disk)
 {
-    std::vector<DirEntry> entries = dir_mgr.ListDirectory(currentInodeId);
-    for (const auto &entry : entries)
+    // 通过目录游标逐块遍历，不拷贝整个目录
+    DirCursor cursor;
+    if (!dir_mgr.OpenDir(currentInodeId, cursor))
+        return;
+    const DirEntry *batch;
+    uint32_t count;
+    while ((count = dir_mgr.ReadDir(cursor, batch)) > 0)
     {
-        std::string name(entry.name);
-        if (name == "." || name == "..")
-            continue;
-        Inode node;
-        // 需要通过 DiskManager 读取该条目对应的 Inode 获取类型
-        if (disk->ReadInode(entry.inode_id, node))
+        for (uint32_t i = 0; i < count; ++i)
         {
+            const DirEntry &entry = batch[i];
+            std::string name(entry.name);
+            if (name == "." || name == "..")
+                continue;
+            // 需要通过 DiskManager 获取该条目对应的 Inode 类型（钉住缓存中的 Inode，无需拷贝）
+            const Inode *node = disk->PinInode(entry.inode_id);
+            if (node == nullptr)
+                continue;
             // 1. 提取类型和权限
-            uint32_t fileType = node.mode >> 9;
+            uint32_t fileType = node->mode >> 9;
             std::string typeTag = (fileType == 2 ? "[DIR]" : "[FILE]");
-            uint32_t permissions = node.mode & 0777;
+            uint32_t permissions = node->mode & 0777;
             // 2. 构造权限字符串
             std::string permStr = GetPermString(permissions);
             // 3. 格式化输出
-            std::cout << std::left
-                      << std::setw(8) << typeTag                 // 1. 类型简写 (如 [DIR])
-                      << std::setw(20) << entry.name             // 2. 文件名 (留宽一点)
-                      << "UID:" << std::setw(6) << node.owner_id // 3. 所有者
-                      << "GID:" << std::setw(6) << node.group_id // 4. 所属组
-                      << "  " << permStr                         // 5. 权限位
+            SessionOut() << std::left
+                      << std::setw(8) << typeTag                  // 1. 类型简写 (如 [DIR])
+                      << std::setw(20) << entry.name              // 2. 文件名 (留宽一点)
+                      << "UID:" << std::setw(6) << node->owner_id // 3. 所有者
+                      << "GID:" << std::setw(6) << node->group_id // 4. 所属组
+                      << "  " << permStr                          // 5. 权限位
                       << std::endl;
+            disk->UnpinInode(entry.inode_id);
         }
     }
 }
 
+// 显示缓存命中统计
+void Shell::ShowCacheStats(DiskManager &dm, DirectoryManager &dirm)
+{
+    auto printStats = [](const std::string &label, const CacheStats &stats)
+    {
+        uint64_t total = stats.hits + stats.misses;
+        double hitRate = (total == 0) ? 0.0 : 100.0 * stats.hits / total;
+        SessionOut() << label
+                  << "  命中 " << stats.hits
+                  << "  未命中 " << stats.misses
+                  << "  命中率 " << std::fixed << std::setprecision(1) << hitRate << "%" << std::defaultfloat
+                  << "  写回 " << stats.writebacks << std::endl;
+    };
+    printStats("块缓存    (容量 " + std::to_string(CACHE_CAPACITY) + ")", dm.GetCacheStats());
+    printStats("Inode缓存 (容量 " + std::to_string(INODE_CACHE_CAPACITY) + ")", dm.GetInodeCacheStats());
+    DentryStats dentry = dirm.GetDentryStats();
+    uint64_t lookups = dentry.hits + dentry.misses;
+    double dentryHitRate = (lookups == 0) ? 0.0 : 100.0 * dentry.hits / lookups;
+    SessionOut() << "目录项缓存 (容量 " << DENTRY_CACHE_CAPACITY << ")"
+              << "  命中 " << dentry.hits << " (否定 " << dentry.negative_hits << ")"
+              << "  未命中 " << dentry.misses
+              << "  命中率 " << std::fixed << std::setprecision(1) << dentryHitRate << "%" << std::defaultfloat
+              << "  失效 " << dentry.invalidations << std::endl;
+}
+
+// 显示磁盘空间使用情况
+void Shell::ShowDiskUsage(DiskManager &dm)
+{
+    SpaceInfo info = dm.GetSpaceInfo();
+    uint32_t used = info.data_blocks - info.free_blocks;
+    SessionOut() << "数据区: " << info.data_blocks << " 块 (" << (uint64_t)info.data_blocks * BLOCK_SIZE / 1024 << "KB)"
+              << "  已用 " << used << " 块"
+              << "  可用 " << info.free_blocks << " 块 (" << (uint64_t)info.free_blocks * BLOCK_SIZE / 1024 << "KB)"
+              << "  最大连续空闲 " << info.largest_free_run << " 块"
+              << "  分配组 " << info.groups << " 个" << std::endl;
+}
+
 // 格式化权限位为可读字符串
 std::string Shell::GetPermString(uint32_t permissions)
 {
@@ -205,116 +413,135 @@ void Shell::ExecuteCD(const std::string &path, FileManager &fm)
 }
 
 // 执行删除文件逻辑
-void Shell::ExecuteRM(const std::string &filename, DirectoryManager &dirm, FileManager &fm, DiskManager *disk, LockManager &lm, SystemContext &ctx)
+void Shell::ExecuteRM(const std::string &filename, FileManager &fm, SystemContext &ctx)
 {
     // 1. 权限预检：检查父目录权限
     // 访客拦截逻辑
     if (ctx.currentUser.groupId == GID_GUEST)
     {
-        std::cerr << "权限拒绝：访客账户无法执行 rm 操作！" << std::endl;
+        SessionErr() << "权限拒绝：访客账户无法执行 rm 操作！" << std::endl;
         return;
     }
     // 删除文件本质是修改父目录的内容（移除目录项），所以必须有父目录的 W 权限
     uint32_t parentInodeId = fm.GetCurrentInodeId();
     if (!fm.HasPermission(parentInodeId, PERM_W, ctx.currentUser))
     {
-        std::cerr << "权限拒绝：您没有父目录的写权限！" << std::endl;
+        SessionErr() << "权限拒绝：您没有父目录的写权限！" << std::endl;
         return;
     }
-    // 2. 安全检查：获取该文件的 Inode
-    uint32_t inodeId = dirm.FindInodeId(filename, parentInodeId);
-    if (inodeId == (uint32_t)-1)
-    {
-        std::cerr << "错误: 无法删除 '" << filename << "': 没有那个文件或目录！" << std::endl;
-        return;
-    }
-    // 3. 申请写权限
-    if (!lm.RequestAccess(inodeId, true))
-    {
-        std::cerr << "文件保护：无法删除 '" << filename << "'正在被其他用户访问，请稍后再试!" << std::endl;
-        return;
-    }
-    // 4. 执行删除
+    // 2. 执行删除：查找、申请文件的写访问权和移除目录项都在持有父目录写访问权期间完成（见 DeleteFile）
     if (fm.DeleteFile(filename))
     { // 删除成功，模拟 Linux 默认不输出
     }
     else
-        std::cerr << "rm: 删除失败" << std::endl;
-    // 无论删除成功与否，操作结束必须释放锁
-    lm.ReleaseAccess(inodeId, true);
+        SessionErr() << "rm: 删除失败" << std::endl;
 }
 
-// 执行显示文件内容逻辑
-void Shell::ExecuteCat(const std::string &filename, DiskManager &dm, DirectoryManager &dirm, LockManager &lm, FileManager &fm, SystemContext &ctx)
+// 执行显示文件内容逻辑：以只读方式打开后把数据块直接流式写出，不在内存中拼出整个文件
+void Shell::ExecuteCat(const std::string &filename, FileManager &fm)
 {
-    // 获取文件的 Inode ID (必须先知道 ID 才能锁住对应的资源)
-    uint32_t inodeId = dirm.FindInodeId(filename, fm.GetCurrentInodeId());
-    if (inodeId == (uint32_t)-1)
-    {
-        std::cout << "错误：文件 '" << filename << "' 不存在!" << std::endl;
+    // 1. 打开文件（内部完成类型检查、读权限校验并申请读访问权）
+    int fd = fm.Open(filename, OPEN_READ);
+    if (fd < 0)
         return;
-    }
-    Inode targetNode;
-    dm.ReadInode(inodeId, targetNode);
-    // 检查是否为目录：cat 不能查看目录内容
-    if ((targetNode.mode >> 9) == 2)
-    {
-        std::cout << "错误: " << filename << ":是一个目录！" << std::endl;
-        return;
-    }
-    // 权限校验：必须拥有读权限 (PERM_R)
-    if (!fm.HasPermission(inodeId, PERM_R, ctx.currentUser))
-    {
-        std::cout << "权限拒绝：您没有当前文件的读权限！" << std::endl;
+    // 2. 先清空输出流的缓冲，保证输出顺序，再绕过输出流直接写输出描述符（服务模式下是会话的连接）
+    SessionOut().flush();
+    fm.SendFile(fd, SessionFd());
+    SessionOut() << std::endl;
+    // 3. 关闭文件，释放读访问权
+    fm.Close(fd);
+}
+
+// 执行写入文件逻辑：append 为 false 时覆盖原内容，为 true 时追加到末尾
+void Shell::ExecuteWrite(const std::string &filename, const std::string &content, bool append, FileManager &fm)
+{
+    // 1. 以写方式打开（内部完成类型检查、写权限校验并申请写访问权）
+    int fd = fm.Open(filename, OPEN_WRITE | (append ? OPEN_APPEND : 0));
+    if (fd < 0)
         return;
-    }
-    // 申请“读权限” (isWrite = false)
-    if (lm.RequestAccess(inodeId, false))
-    {
-        // std::this_thread::sleep_for(std::chrono::seconds(10)); // 模拟读大文件耗时
-        // 执行读取操作
-        std::cout << fm.ReadFile(filename) << std::endl;
-        // 读取完成后，必须释放读权限
-        lm.ReleaseAccess(inodeId, false);
-    }
+    // 2. 追加直接写在末尾；覆盖写入在空间不足时失败并保留原内容（见 Overwrite），然后关闭文件，释放写访问权
+    if (append)
+        fm.Write(fd, content.data(), (uint32_t)content.size());
     else
-        // 如果返回 false，说明此时有人正在“写”或者“删除”该文件
-        std::cout << "文件保护：文件 '" << filename << "' 正在被其他用户访问，请稍后再试!" << std::endl;
+        fm.Overwrite(fd, content.data(), (uint32_t)content.size());
+    fm.Close(fd);
 }
 
-// 执行写入文件逻辑
-void Shell::ExecuteWrite(const std::string &filename, const std::string &content, DiskManager &dm, DirectoryManager &dirm, LockManager &lm, FileManager &fm, SystemContext &ctx)
+// 显示文件开头或末尾的若干行：按块从相应一端读取，找够行数即停止，不读取整个文件
+void Shell::ExecuteHeadTail(const std::string &filename, uint32_t lines, bool fromEnd, FileManager &fm)
 {
-    // 1. 查找 Inode ID
-    uint32_t inodeId = dirm.FindInodeId(filename, fm.GetCurrentInodeId());
-    if (inodeId == (uint32_t)-1)
-    {
-        std::cout << "错误：文件 '" << filename << "' 不存在!" << std::endl;
+    int fd = fm.Open(filename, OPEN_READ);
+    if (fd < 0)
         return;
-    }
-    Inode targetNode;
-    dm.ReadInode(inodeId, targetNode);
-    // 2. 检查是否为目录：write 不能写入目录
-    if ((targetNode.mode >> 9) == 2)
+    // 1. 每次读取若干块，逐字节数换行
+    const uint32_t chunk = 4 * BLOCK_SIZE;
+    std::vector<char> buf(chunk);
+    uint32_t found = 0;
+    std::string out;
+    if (!fromEnd)
     {
-        std::cout << "错误: " << filename << ":是一个目录！" << std::endl;
-        return;
+        // head：从头向后找第 lines 个换行
+        int64_t n;
+        while (found < lines && (n = fm.Read(fd, buf.data(), chunk)) > 0)
+        {
+            int64_t used = n;
+            for (int64_t i = 0; i < n; ++i)
+                if (buf[i] == '\n' && ++found == lines)
+                {
+                    used = i + 1;
+                    break;
+                }
+            out.append(buf.data(), used);
+        }
     }
-    // 3. 权限校验：必须拥有写权限 (PERM_W)
-    if (!fm.HasPermission(inodeId, PERM_W, ctx.currentUser))
+    else if (lines > 0)
     {
-        std::cout << "权限拒绝：您没有当前文件的写权限！" << std::endl;
-        return;
+        // tail：从末尾向前找第 lines 个换行（文件最后一个字节的换行不算），再读出其后的内容
+        uint32_t size = (uint32_t)fm.Seek(fd, 0, SEEK_END);
+        uint32_t start = size;
+        bool done = false;
+        while (start > 0 && !done)
+        {
+            uint32_t n = std::min(chunk, start);
+            start -= n;
+            fm.Seek(fd, start, SEEK_SET);
+            if (fm.Read(fd, buf.data(), n) != n)
+                break;
+            for (uint32_t i = n; i-- > 0;)
+                if (buf[i] == '\n' && start + i != size - 1 && ++found == lines)
+                {
+                    start += i + 1;
+                    done = true;
+                    break;
+                }
+        }
+        out.resize(size - start);
+        fm.Seek(fd, start, SEEK_SET);
+        int64_t n = fm.Read(fd, &out[0], size - start);
+        out.resize(n > 0 ? n : 0);
     }
-    // 4. 申请写权限
-    if (lm.RequestAccess(inodeId, true))
+    fm.Close(fd);
+    // 2. 输出，最后一行没有换行时补一个
+    SessionOut() << out;
+    if (!out.empty() && out.back() != '\n')
+        SessionOut() << std::endl;
+}
+
+// 从文件描述符的当前位置读取 count 字节并输出，count 为 0 时读到文件末尾
+void Shell::ExecuteRead(int fd, uint32_t count, FileManager &fm)
+{
+    std::vector<char> buf(16 * BLOCK_SIZE);
+    uint32_t total = 0;
+    while (count == 0 || total < count)
     {
-        // 5. 执行实际的写入操作
-        fm.WriteFile(filename, content);
-        // 6. 操作完成后必须释放权限
-        lm.ReleaseAccess(inodeId, true);
+        uint32_t want = (count == 0) ? buf.size() : std::min<uint32_t>(buf.size(), count - total);
+        int64_t n = fm.Read(fd, buf.data(), want);
+        if (n <= 0)
+            break;
+        SessionOut().write(buf.data(), n);
+        total += n;
     }
-    else
-        // 如果 RequestAccess 返回 false，说明有人正在 cat (读) 或正在 write (写)
-        std::cout << "文件保护：文件 '" << filename << "' 正在被其他用户访问，请稍后再试!" << std::endl;
-}
\ No newline at end of file
+    SessionOut() << std::endl;
+}
+
+} // namespace FS_NAMESPACE
@@ -8,22 +8,34 @@
 #include "FileSystem.h"
 #include "LockManager.h"
 
+namespace FS_NAMESPACE
+{
+
 class Shell
 {
 public:
     void Run(DiskManager &dm, UserManager &um, DirectoryManager &dirm, FileManager &fm, LockManager &lm, SystemContext &ctx);
+    bool ExecuteLine(const std::string &input, DiskManager &dm, UserManager &um, DirectoryManager &dirm, FileManager &fm, LockManager &lm, SystemContext &ctx);
+    void PrintPrompt(SystemContext &ctx, FileManager &fm);
+    bool IsExclusive(const std::string &input);
+    bool IsMutating(const std::vector<std::string> &args);
 
 private:
     std::vector<std::string> ParseInput(const std::string &input);
     void ExecuteCommand(const std::vector<std::string> &args, DiskManager &dm, UserManager &um, DirectoryManager &dirm, FileManager &fm, LockManager &lm, SystemContext &ctx);
     void ShowHelp();
-    void PrintPrompt(SystemContext &ctx, FileManager &fm);
     void ShowList(uint32_t currentInodeId, DirectoryManager &dir_mgr, DiskManager *disk);
+    void ShowCacheStats(DiskManager &dm, DirectoryManager &dirm);
+    void ShowDiskUsage(DiskManager &dm);
     std::string GetPermString(uint32_t permissions);
     void ExecuteCD(const std::string &path, FileManager &fm);
-    void ExecuteRM(const std::string &filename, DirectoryManager &dirm, FileManager &fm, DiskManager *disk, LockManager &lm, SystemContext &ctx);
-    void ExecuteCat(const std::string &filename, DiskManager &dm, DirectoryManager &dirm, LockManager &lm, FileManager &fm, SystemContext &ctx);
-    void ExecuteWrite(const std::string &filename, const std::string &content, DiskManager &dm, DirectoryManager &dirm, LockManager &lm, FileManager &fm, SystemContext &ctx);
+    void ExecuteRM(const std::string &filename, FileManager &fm, SystemContext &ctx);
+    void ExecuteCat(const std::string &filename, FileManager &fm);
+    void ExecuteWrite(const std::string &filename, const std::string &content, bool append, FileManager &fm);
+    void ExecuteHeadTail(const std::string &filename, uint32_t lines, bool fromEnd, FileManager &fm);
+    void ExecuteRead(int fd, uint32_t count, FileManager &fm);
 };
 
-#endif
\ No newline at end of file
+} // namespace FS_NAMESPACE
+
+#endif
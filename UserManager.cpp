@@ -1,5 +1,8 @@
 #include "UserManager.h"
 
+namespace FS_NAMESPACE
+{
+
 UserManager::UserManager() {}
 
 // 保存用户数据到文件
@@ -10,7 +13,7 @@ void UserManager::SaveUsersToFile(SystemContext &ctx)
     std::ofstream outFile(filename, std::ios::out | std::ios::trunc);
     if (!outFile.is_open())
     {
-        std::cerr << "错误：无法打开文件进行写入！" << std::endl;
+        SessionErr() << "错误：无法打开文件进行写入！" << std::endl;
         return;
     }
     // 遍历 UserList 中的每一个用户
@@ -48,7 +51,7 @@ void UserManager::SwitchUser(SystemContext &ctx, const std::vector<std::string>
     }
     catch (...)
     {
-        std::cout << "错误：请输入有效的数字 ID！" << std::endl;
+        SessionOut() << "错误：请输入有效的数字 ID！" << std::endl;
         return;
     }
     // 1. 在 uList 中查找用户是否存在
@@ -59,17 +62,17 @@ void UserManager::SwitchUser(SystemContext &ctx, const std::vector<std::string>
     {
         if (it->groupId != targetGroupId && ctx.currentUser.groupId == GID_ROOT && targetGroupId != GID_ROOT)
         {
-            std::cout << "修改 ID 为" << targetId << " 的组身份从 " << it->groupId << " 变更为 " << targetGroupId << std::endl;
+            SessionOut() << "修改 ID 为" << targetId << " 的组身份从 " << it->groupId << " 变更为 " << targetGroupId << std::endl;
             it->groupId = targetGroupId; // 更新列表中的组信息
         }
         else if (it->groupId != targetGroupId && ctx.currentUser.groupId == GID_ROOT)
         {
-            std::cout << "错误：无法将用户修改为管理员！" << std::endl;
+            SessionOut() << "错误：无法将用户修改为管理员！" << std::endl;
             return;
         }
         else if (it->groupId != targetGroupId)
         {
-            std::cout << "错误：当前用户组身份无权限修改组身份！" << std::endl;
+            SessionOut() << "错误：当前用户组身份无权限修改组身份！" << std::endl;
             return;
         }
         ctx.currentUser = *it; // 赋值给当前会话
@@ -77,14 +80,14 @@ void UserManager::SwitchUser(SystemContext &ctx, const std::vector<std::string>
     else
         AddUser(ctx, targetId, targetGroupId);
     // 3. 执行切换逻辑
-    std::cout << "身份已切换至: ";
+    SessionOut() << "身份已切换至: ";
     if (ctx.currentUser.groupId == GID_ROOT)
-        std::cout << "管理员";
+        SessionOut() << "管理员";
     else if (ctx.currentUser.groupId == GID_USERS)
-        std::cout << "用户" << ctx.currentUser.userId;
+        SessionOut() << "用户" << ctx.currentUser.userId;
     else if (ctx.currentUser.groupId == GID_GUEST)
-        std::cout << "访客" << ctx.currentUser.userId;
-    std::cout << std::endl;
+        SessionOut() << "访客" << ctx.currentUser.userId;
+    SessionOut() << std::endl;
 }
 
 // 添加用户
@@ -94,5 +97,7 @@ void UserManager::AddUser(SystemContext &ctx, int targetId, int targetGroupId)
     newUser.userId = targetId;
     newUser.groupId = targetGroupId;
     ctx.uList.push_back(newUser);
-    std::cout << "检测到新用户，已自动创建 UID: " << targetId << " GID: " << targetGroupId << std::endl;
-}
\ No newline at end of file
+    SessionOut() << "检测到新用户，已自动创建 UID: " << targetId << " GID: " << targetGroupId << std::endl;
+}
+
+} // namespace FS_NAMESPACE
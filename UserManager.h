@@ -4,6 +4,9 @@
 #include "FileSystem.h"
 #include <string>
 
+namespace FS_NAMESPACE
+{
+
 class UserManager
 {
 private:
@@ -18,4 +21,6 @@ public:
     void AddUser(SystemContext &ctx, int targetId, int targetGroupId);
 };
 
-#endif
\ No newline at end of file
+} // namespace FS_NAMESPACE
+
+#endif
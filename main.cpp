@@ -1,38 +1,37 @@
-#include "DiskManager.h"
-#include "UserManager.h"
-#include "DirectoryManager.h"
-#include "FileManager.h"
-#include "Shell.h"
-#include "FileSystem.h"
-#include "LockManager.h"
+#include "Launcher.h"
 
-int main()
+// 4096 字节块的一份由 FileSystem4096.cpp 编译生成，这里只声明入口
+namespace fs4096
 {
-    SetConsoleOutputCP(65001); // 强制更改终端编码
+int RunFileSystem(int argc, char *argv[]);
+}
 
-    SystemContext ctx;
-    DiskManager dm(VDISK_PATH);
-    UserManager um;
-    DirectoryManager dirm(&dm);
-    FileManager fm(&dm, &dirm, &ctx);
-    LockManager lm(&dm);
-    Shell shell;
+int main(int argc, char *argv[])
+{
+#ifdef _WIN32
+    SetConsoleOutputCP(65001); // 强制更改终端编码
+#endif
 
-    // 读入用户列表
-    um.LoadUsers(ctx);
-    ctx.currentUser.userId = 0;
-    ctx.currentUser.groupId = GID_ROOT;
-    // 初始化系统
-    if (!dm.FileExists(VDISK_PATH))
+    // 选出块大小：镜像已存在时以超级块中记录的为准（旧镜像记为 0，即 512 字节），
+    // 否则取 --block-size=N，首次初始化时按它格式化
+    uint32_t blockSize = 512;
+    for (int i = 1; i < argc; ++i)
     {
-        std::cout << "检测到镜像不存在，正在进行首次初始化..." << std::endl;
-        dm.InitializeDisk(VDISK_PATH);
-        dirm.InitializeRoot();
+        std::string arg = argv[i];
+        if (arg.compare(0, 13, "--block-size=") == 0)
+            blockSize = (uint32_t)strtoul(arg.c_str() + 13, nullptr, 10);
     }
-    else
-        dm.Mount();
-    // 启动 Shell
-    shell.Run(dm, um, dirm, fm, lm, ctx);
-
-    return 0;
-}
\ No newline at end of file
+    std::ifstream image(fs512::VDISK_PATH, std::ios::binary);
+    fs512::SuperBlock sb;
+    if (image.read(reinterpret_cast<char *>(&sb), sizeof(sb)))
+        blockSize = (sb.block_size == 0) ? 512 : sb.block_size;
+    image.close();
+    if (blockSize == 4096)
+        return fs4096::RunFileSystem(argc, argv);
+    if (blockSize != 512)
+    {
+        std::cerr << "错误：不支持 " << blockSize << " 字节的块，块大小只能是 512 或 4096" << std::endl;
+        return 1;
+    }
+    return fs512::RunFileSystem(argc, argv);
+}